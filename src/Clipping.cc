@@ -0,0 +1,140 @@
+#include "Clipping.hh"
+
+#include "Geometry.hh"
+
+using Types::Vec3f;
+using Types::Vec4f;
+using Types::Mat4f;
+
+namespace Clipping {
+
+    // obs.: vertices are clipped to half of the guard band, so that rounding errors
+    //       never push them out of it (where the rasterizer would drop the triangle)
+    static const float CLIP_GUARD_BAND = 0.5f * Geometry::GUARD_BAND;
+
+    enum Plane { NEAR, LEFT, RIGHT, BOTTOM, TOP, N_PLANES };
+
+    // Vertex of a triangle being clipped
+    struct Vertex {
+        Vec4f clip_coord;
+        Vec3f weights; // barycentric coordinates w.r.t. the original triangle
+    };
+
+    // Signed distance of a vertex to a clipping plane (positive inside of it)
+    static float distance(const Vec4f &clip_coord, const Mat4f &viewport, int plane) {
+        if (plane == NEAR)
+            return clip_coord.w - NEAR_W;
+
+        // obs.: the viewport is affine, so clipping homogeneous screen coordinates
+        //       is the same as clipping clip space ones, and then mapping them
+        const Vec4f screen_coord = viewport * clip_coord;
+        switch (plane) {
+            case LEFT:   return CLIP_GUARD_BAND * screen_coord.w + screen_coord.x;
+            case RIGHT:  return CLIP_GUARD_BAND * screen_coord.w - screen_coord.x;
+            case BOTTOM: return CLIP_GUARD_BAND * screen_coord.w + screen_coord.y;
+            default:     return CLIP_GUARD_BAND * screen_coord.w - screen_coord.y;
+        }
+    }
+
+    // Bit mask of the planes a vertex is outside of
+    static int outcode(const Vec4f &clip_coord, const Mat4f &viewport) {
+        int code = 0;
+        for (int plane = 0; plane < N_PLANES; ++plane)
+            if (distance(clip_coord, viewport, plane) < 0)
+                code |= 1 << plane;
+        return code;
+    }
+
+    static Vec3f to_screen_space(const Vec4f &clip_coord, const Mat4f &viewport) {
+        // convert clip space to NDC through perspective division,
+        // and then NDC to screen space through Viewport transform
+        return (viewport * clip_coord.homogenized()).xyz();
+    }
+
+    // Sutherland-Hodgman clipping of a convex polygon against a single plane
+    static int clip_polygon(
+        const Vertex in[], int n_in, int plane, const Mat4f &viewport,
+        Vertex out[]
+    ) {
+        float d[MAX_VERTICES];
+        for (int i = 0; i < n_in; ++i)
+            d[i] = distance(in[i].clip_coord, viewport, plane);
+
+        int n_out = 0;
+        for (int i = 0; i < n_in; ++i) {
+            const int j = (i + 1) % n_in;
+            if (d[i] >= 0)
+                out[n_out++] = in[i];
+
+            if ((d[i] >= 0) != (d[j] >= 0)) {
+                // obs.: always interpolate from the inside vertex, so that an edge shared
+                //       by two triangles is cut at the exact same point in both (no cracks)
+                const int inside = d[i] >= 0 ? i : j;
+                const int outside = d[i] >= 0 ? j : i;
+                const float t = d[inside] / (d[inside] - d[outside]);
+                out[n_out].clip_coord = in[inside].clip_coord + (in[outside].clip_coord - in[inside].clip_coord) * t;
+                out[n_out].weights = in[inside].weights + (in[outside].weights - in[inside].weights) * t;
+                ++n_out;
+            }
+        }
+        return n_out;
+    }
+
+    int clip(const Vec4f clip_coords[3], const Mat4f &viewport,
+             Triangle triangles[MAX_TRIANGLES]) {
+        int outside_all = ~0; // planes all vertices are outside of
+        int outside_any = 0;  // planes the triangle crosses (or is outside of)
+        for (int j = 0; j < 3; ++j) {
+            const int code = outcode(clip_coords[j], viewport);
+            outside_all &= code;
+            outside_any |= code;
+        }
+
+        if (outside_all != 0)
+            return 0; // trivial rejection, i.e. entirely outside of the same plane
+
+        if (outside_any == 0) {
+            // trivial acceptance
+            for (int j = 0; j < 3; ++j) {
+                triangles[0].screen_coords[j] = to_screen_space(clip_coords[j], viewport);
+                triangles[0].weights.set_col(j, Vec3f(j == 0, j == 1, j == 2)); // i.e. the identity
+            }
+            triangles[0].is_clipped = false;
+            return 1;
+        }
+
+        Vertex polygons[2][MAX_VERTICES];
+        for (int j = 0; j < 3; ++j) {
+            polygons[0][j].clip_coord = clip_coords[j];
+            polygons[0][j].weights = Vec3f(j == 0, j == 1, j == 2);
+        }
+
+        int n_vertices = 3;
+        int current = 0;
+        for (int plane = 0; plane < N_PLANES; ++plane) {
+            if (outside_any & (1 << plane)) {
+                n_vertices = clip_polygon(polygons[current], n_vertices, plane, viewport, polygons[1 - current]);
+                current = 1 - current;
+                if (n_vertices < 3)
+                    return 0;
+            }
+        }
+        const Vertex *polygon = polygons[current];
+
+        Vec3f screen_coords[MAX_VERTICES];
+        for (int i = 0; i < n_vertices; ++i)
+            screen_coords[i] = to_screen_space(polygon[i].clip_coord, viewport);
+
+        // triangulate the (convex) polygon as a fan, which keeps the original winding
+        for (int k = 1; k + 1 < n_vertices; ++k) {
+            Triangle &triangle = triangles[k - 1];
+            const int vertices[3] = { 0, k, k + 1 };
+            for (int j = 0; j < 3; ++j) {
+                triangle.screen_coords[j] = screen_coords[vertices[j]];
+                triangle.weights.set_col(j, polygon[vertices[j]].weights);
+            }
+            triangle.is_clipped = true;
+        }
+        return n_vertices - 2;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef __CLIPPING_HH__
+#define __CLIPPING_HH__
+
+#include "Types.hh"
+
+namespace Clipping {
+
+    // The projection doesn't map a near plane, so vertices are kept a bit in front of the camera
+    // plane (w = 0) instead, where the perspective divide would blow up (or flip) their positions
+    static const float NEAR_W = 1e-3f;
+
+    // Each plane a triangle is clipped against may add one vertex to it (near, and 4 guard band planes)
+    static const int MAX_VERTICES = 3 + 5;
+    static const int MAX_TRIANGLES = MAX_VERTICES - 2;
+
+    ///////////////////////////////////////////////////////
+    /// Triangle //////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Part of a clipped triangle, already in screen space
+    // obs.: the varyings of the original triangle are clipped through weights, as its columns
+    //       are the barycentric coordinates of each vertex w.r.t. the original triangle, so that
+    //       weights * (barycentric coordinates in this triangle) is where to interpolate them
+    struct Triangle {
+        Types::Vec3f screen_coords[3];
+        Types::Mat3f weights;
+        bool is_clipped; // false iff this is the original triangle (i.e. weights is the identity)
+    };
+
+    ///////////////////////////////////////////////////////
+    /// clipping //////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Clips a triangle given in clip space (i.e. before the perspective divide) against the near plane,
+    // and against the sides of the guard band (Geometry::GUARD_BAND, in screen space) when it leaves it,
+    // then maps what's left of it to screen space through viewport, as a fan of triangles
+    // Returns how many triangles were written to triangles (0 if it was entirely clipped away)
+    // obs.: triangles that don't cross any plane (i.e. nearly all of them) are returned as is
+    int clip(
+        const Types::Vec4f clip_coords[3], const Types::Mat4f &viewport,
+        Triangle triangles[MAX_TRIANGLES]
+    );
+}
+
+#endif // __CLIPPING_HH__
\ No newline at end of file
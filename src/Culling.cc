@@ -0,0 +1,80 @@
+#include "Culling.hh"
+
+using Types::Vec2i;
+using Types::Vec3f;
+
+namespace Culling {
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    long Stats::n_culled() const {
+        return n_back_faces + n_off_screen + n_empty;
+    }
+
+    void Stats::clear() {
+        *this = Stats();
+    }
+
+    Stats &Stats::operator+=(const Stats &stats) {
+        n_triangles += stats.n_triangles;
+        n_back_faces += stats.n_back_faces;
+        n_off_screen += stats.n_off_screen;
+        n_empty += stats.n_empty;
+        return *this;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats) {
+        out << "culled " << stats.n_culled() << " of " << stats.n_triangles << " triangles"
+            << " (back faces: " << stats.n_back_faces
+            << ", off-screen: " << stats.n_off_screen
+            << ", empty: " << stats.n_empty << ")";
+        return out;
+    }
+
+    ///////////////////////////////////////////////////////
+    /// culling ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    bool cull(const Vec3f screen_coords[3], const Vec2i &resolution,
+              const Options &options, Stats &stats, Geometry::TriangleEdges &edges) {
+        ++stats.n_triangles;
+
+        const Vec3f &a = screen_coords[0];
+        const Vec3f &b = screen_coords[1];
+        const Vec3f &c = screen_coords[2];
+
+        if (options.off_screen) {
+            // trivial rejection, i.e. all vertices are outside of the same screen border
+            if ((a.x < 0 && b.x < 0 && c.x < 0) ||
+                (a.y < 0 && b.y < 0 && c.y < 0) ||
+                (a.x > resolution.x && b.x > resolution.x && c.x > resolution.x) ||
+                (a.y > resolution.y && b.y > resolution.y && c.y > resolution.y)) {
+                ++stats.n_off_screen;
+                return true;
+            }
+        }
+
+        // obs.: use the same (snapped) positions as the rasterizer
+        edges = Geometry::TriangleEdges(Geometry::TriangleXY<float>(a, b, c));
+        if (!edges.is_in_guard_band)
+            return false; // left for clipping (or for the rasterizer to reject)
+
+        if (options.empty) {
+            if (edges.is_degenerate || edges.bbox_min.x > edges.bbox_max.x || edges.bbox_min.y > edges.bbox_max.y) {
+                ++stats.n_empty;
+                return true;
+            }
+        }
+
+        if (options.back_faces) {
+            if (edges.is_clockwise) {
+                ++stats.n_back_faces;
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
\ No newline at end of file
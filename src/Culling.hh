@@ -0,0 +1,59 @@
+#ifndef __CULLING_HH__
+#define __CULLING_HH__
+
+#include <iostream>
+
+#include "Types.hh"
+#include "Geometry.hh"
+
+namespace Culling {
+
+    ///////////////////////////////////////////////////////
+    /// Options ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Tests run on each triangle (in screen space) before it's rasterized
+    struct Options {
+        bool back_faces = true; // cull triangles facing away from the camera (i.e. clockwise on screen)
+        bool off_screen = true; // cull triangles entirely outside of the screen
+        bool empty = true;      // cull zero area triangles, and those whose bounding box has no pixel center (e.g. sub-pixel ones)
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Number of triangles removed by each test
+    struct Stats {
+        long n_triangles = 0; // tested
+        long n_back_faces = 0;
+        long n_off_screen = 0;
+        long n_empty = 0;
+
+        long n_culled() const;
+
+        void clear();
+
+        Stats &operator+=(const Stats &stats);
+    };
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats);
+
+    ///////////////////////////////////////////////////////
+    /// culling ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Returns true iff the triangle shouldn't be rasterized on a screen of the given resolution,
+    // counting the test that removed it in stats, and otherwise sets edges up from it, so that
+    // they're passed on to the rasterizer (see Draw::triangle) instead of being set up again
+    // obs.: tests are run from the cheapest to the most expensive one, and depth isn't tested,
+    //       as nothing clips it to the [near, far] range (i.e. any depth is kept in the z-buffer)
+    // obs.: a triangle that isn't culled may still cover no pixel center (e.g. a thin one),
+    //       which only the rasterizer finds
+    bool cull(
+        const Types::Vec3f screen_coords[3], const Types::Vec2i &resolution,
+        const Options &options, Stats &stats, Geometry::TriangleEdges &edges
+    );
+}
+
+#endif // __CULLING_HH__
\ No newline at end of file
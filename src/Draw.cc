@@ -2,9 +2,6 @@
 
 #include <algorithm>
 
-#include "Math.hh"
-#include "Geometry.hh"
-
 using Types::Vec2i;
 using Types::Vec3i;
 
@@ -76,37 +73,21 @@ namespace Draw {
     ///////////////////////////////////////////////////////
 
     void triangle(TriangleProps<Types::Vec3f> pos, Shader &shader,
-                  TGAImage &image, float z_buffer[]) {
-        const Vec2i bbox_min = Vec2i(
-            std::max(0.0f, Math::min(pos.a.x, pos.b.x, pos.c.x)),
-            std::max(0.0f, Math::min(pos.a.y, pos.b.y, pos.c.y))
-        ); // max({0, 0}, min(a, b, c))
-
-        const Vec2i bbox_max = Vec2i(
-            std::min(Math::max(pos.a.x, pos.b.x, pos.c.x), image.get_width() - 1.0f),
-            std::min(Math::max(pos.a.y, pos.b.y, pos.c.y), image.get_height() - 1.0f)
-        ); // min(max(a, b, c), {width, height})
-
-        const Vec3f vertex_depths(pos.a.z, pos.b.z, pos.c.z);
-
-        Vec2i p;
-        for (p.x = bbox_min.x; p.x <= bbox_max.x; ++p.x) {
-            for (p.y = bbox_min.y; p.y <= bbox_max.y; ++p.y) {
-                Geometry::PointProps point = Geometry::barycentric_coords(p, Geometry::TriangleXY<int>(pos.a, pos.b, pos.c));
-
-                if (!point.is_inside_triangle)
-                    continue;
+                  Frame::Buffer &framebuffer,
+                  Vec2i origin, HiZ::Pyramid *hiz, DepthTest depth_test,
+                  const Types::Mat3f *weights) {
+        const Kernels::Fragments<Shader>::Source source = { &shader, weights };
+        if (depth_test == DepthTest::Less)
+            Kernels::rasterize<Shader, DepthTest::Less, true>(pos, source, framebuffer, origin, hiz, nullptr);
+        else
+            Kernels::rasterize<Shader, DepthTest::Equal, true>(pos, source, framebuffer, origin, hiz, nullptr);
+    }
 
-                float pz = Geometry::barycentric_interp(point.barycentric_coords, vertex_depths);
-                if (z_buffer[int(p.x + p.y * image.get_width())] < pz) {
-                    TGAColor color;
-                    bool discard = shader.fragment(point.barycentric_coords, color); // sets color
-                    if (!discard) {
-                        z_buffer[int(p.x + p.y * image.get_width())] = pz;
-                        image.set(p.x, p.y, color);
-                    }
-                }
-            }
-        }
+    void triangle_depth(TriangleProps<Types::Vec3f> pos,
+                        Frame::Buffer &framebuffer,
+                        Vec2i origin, HiZ::Pyramid *hiz,
+                        const Geometry::TriangleEdges *edges) {
+        const Kernels::Fragments<Shader>::Source source = { nullptr, nullptr };
+        Kernels::rasterize<Shader, DepthTest::Less, false>(pos, source, framebuffer, origin, hiz, edges);
     }
 }
\ No newline at end of file
@@ -1,11 +1,29 @@
 #ifndef __DRAW_HH__
 #define __DRAW_HH__
 
+#include <cmath>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
 #include "tgaimage.hh"
 
+#include "HiZ.hh"
 #include "Obj.hh"
+#include "Math.hh"
+#include "Frame.hh"
+#include "Simd.hh"
 #include "Types.hh"
 #include "Shader.hh"
+#include "Geometry.hh"
+#include "Interpolation.hh"
+
+// obs.: define DRAW_SCALAR to rasterize one pixel at a time, even when SSE2 is available
+#if defined(__SSE2__) && !defined(DRAW_SCALAR)
+#define DRAW_QUADS
+#include <emmintrin.h>
+#endif
 
 namespace Draw {
 
@@ -13,7 +31,7 @@ namespace Draw {
     struct TriangleProps {
         T a, b, c;
 
-        TriangleProps(T props[3])
+        TriangleProps(const T props[3])
             : a(props[0])
             , b(props[1])
             , c(props[2]) { }
@@ -37,10 +55,636 @@ namespace Draw {
     /// 3D (in screen space) //////////////////////////////
     ///////////////////////////////////////////////////////
 
+    enum class DepthTest {
+        Less,  // passes iff z_buffer[p] < depth, and then writes depth to z_buffer[p]
+        Equal, // passes iff z_buffer[p] == depth (i.e. after a depth pre-pass), without writing it
+    };
+
+    // obs.: framebuffer may only cover part of the screen (e.g. a tile),
+    //       in which case origin is the screen position of its (0, 0) pixel
+    // obs.: if hiz is given, it must cover framebuffer, and it's used to skip hidden
+    //       triangles and blocks of pixels (and kept up to date with its depth)
+    // obs.: if pos is part of a clipped triangle, weights maps its barycentric coordinates to the
+    //       ones of the original triangle, which are passed to the shader (see Clipping::Triangle)
+    // obs.: the barycentric coordinates passed to the shader are in screen space (i.e. not
+    //       perspective correct), as it's only given the vertices' screen positions
+    // obs.: shader.setup_triangle() is called before shading the triangle (if any of it is visible)
+    // obs.: this goes through the virtual Shader interface for every pixel, which the templated
+    //       version below avoids for concrete shader types, so prefer calling it instead
     void triangle(
         TriangleProps<Types::Vec3f> pos, Shader &shader,
-        TGAImage &image, float z_buffer[]
+        Frame::Buffer &framebuffer,
+        Types::Vec2i origin = Types::Vec2i(0, 0),
+        HiZ::Pyramid *hiz = nullptr,
+        DepthTest depth_test = DepthTest::Less,
+        const Types::Mat3f *weights = nullptr
+    );
+
+    // Same as above, but specialized at compile time for ShaderT, so that its fragment()
+    // can be inlined into the rasterization kernels (instead of called through a vtable)
+    // obs.: instead of barycentric coordinates, fragment() is passed the values of the varyings
+    //       ShaderT declares, interpolated with perspective correction (see Kernels::Fragments)
+    //       from the ones in triangle (i.e. of the original triangle, if pos was clipped)
+    // obs.: shader is only read (see Shaders), so any number of threads can draw with it at once, and
+    //       its per-triangle constants (if any) are returned by its setup_triangle() instead, which is
+    //       called before shading the triangle (if any of it is visible), see Kernels::TriangleSetup
+    // obs.: if edges is given, it must have been set up from pos (e.g. by Culling::cull), so that
+    //       it isn't set up again
+    template <typename ShaderT>
+    void triangle(
+        TriangleProps<Types::Vec3f> pos, const ShaderT &shader,
+        const Interpolation::Triangle<typename ShaderT::Varyings> &triangle,
+        Frame::Buffer &framebuffer,
+        Types::Vec2i origin = Types::Vec2i(0, 0),
+        HiZ::Pyramid *hiz = nullptr,
+        DepthTest depth_test = DepthTest::Less,
+        const Types::Mat3f *weights = nullptr,
+        const Geometry::TriangleEdges *edges = nullptr
+    );
+
+    // Depth only version of triangle(), that never calls the shader (nor writes colors),
+    // for a depth pre-pass: drawing everything with it first, and then with triangle() and
+    // DepthTest::Equal, shades each pixel only once (i.e. by the visible triangle)
+    // obs.: the pre-pass is only correct for shaders that never discard pixels, and where
+    //       triangles have the exact same depth, the last one drawn wins (not the first)
+    void triangle_depth(
+        TriangleProps<Types::Vec3f> pos,
+        Frame::Buffer &framebuffer,
+        Types::Vec2i origin = Types::Vec2i(0, 0),
+        HiZ::Pyramid *hiz = nullptr,
+        const Geometry::TriangleEdges *edges = nullptr
     );
+
+    ///////////////////////////////////////////////////////
+    /// Rasterization kernels /////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // obs.: they're templated on the shader type, and so defined in this header,
+    //       to be instantiated (and have fragment() inlined) wherever it's known
+
+    namespace Kernels {
+
+        using Types::Vec2i;
+        using Types::Vec3f;
+        using Types::Vec4f;
+        using Types::Mat3f;
+
+        template <typename T>
+        struct Void { typedef void type; };
+
+        // Per-triangle state of shaders without a setup_triangle() (see TriangleSetup)
+        struct NoTriangleState { };
+
+        // If ShaderT has a per-triangle setup stage, i.e. a const
+        //     State setup_triangle(const Interpolation::Triangle<Varyings> &triangle)
+        // which computes values that are constant over the triangle (e.g. its tangent basis), it's called
+        // once per triangle, before any of its pixels are shaded, and all of its fragment() overloads are
+        // then also passed the State it returned, as their last argument (e.g. for the one below, after
+        // frag_color), so that the shader itself stays immutable
+        // obs.: triangle is the original triangle (i.e. not the clipped one, if it was clipped)
+        template <typename ShaderT, typename = void>
+        struct TriangleSetup {
+            typedef NoTriangleState State;
+
+            static inline State setup(const ShaderT &shader, const Interpolation::Triangle<typename ShaderT::Varyings> &triangle) {
+                return State();
+            }
+
+            template <typename... Args>
+            static inline auto fragment(const ShaderT &shader, const State &state, Args &&... args)
+                -> decltype(shader.fragment(std::forward<Args>(args)...)) {
+                return shader.fragment(std::forward<Args>(args)...);
+            }
+        };
+
+        template <typename ShaderT>
+        struct TriangleSetup<ShaderT, typename Void<decltype(std::declval<const ShaderT &>().setup_triangle(
+            std::declval<const Interpolation::Triangle<typename ShaderT::Varyings> &>()
+        ))>::type> {
+            typedef decltype(std::declval<const ShaderT &>().setup_triangle(
+                std::declval<const Interpolation::Triangle<typename ShaderT::Varyings> &>()
+            )) State;
+
+            static inline State setup(const ShaderT &shader, const Interpolation::Triangle<typename ShaderT::Varyings> &triangle) {
+                return shader.setup_triangle(triangle);
+            }
+
+            template <typename... Args>
+            static inline auto fragment(const ShaderT &shader, const State &state, Args &&... args)
+                -> decltype(shader.fragment(std::forward<Args>(args)..., state)) {
+                return shader.fragment(std::forward<Args>(args)..., state);
+            }
+        };
+
+        // True iff ShaderT's fragment() is also passed the screen space derivatives of the varyings
+        // (e.g. to select the mip level of textures), the same as its quad fragment() takes them:
+        //     bool fragment(const Varyings &interpolated, const Varyings &d_dx, const Varyings &d_dy,
+        //                   const Vec2i &frag_coord, Vec4f &frag_color)
+        // obs.: they're only computed (see Interpolation::Planes::derivatives) for shaders that take them
+        template <typename ShaderT, typename = void>
+        struct HasDerivatives : std::false_type { };
+
+        template <typename ShaderT>
+        struct HasDerivatives<ShaderT, typename Void<decltype(TriangleSetup<ShaderT>::fragment(
+            std::declval<const ShaderT &>(), std::declval<const typename TriangleSetup<ShaderT>::State &>(),
+            std::declval<const typename ShaderT::Varyings &>(), std::declval<const typename ShaderT::Varyings &>(),
+            std::declval<const typename ShaderT::Varyings &>(), std::declval<const Vec2i &>(), std::declval<Vec4f &>()
+        ))>::type> : std::true_type { };
+
+#ifdef DRAW_QUADS
+        // Shades the pixels of the quad at p in mask (with lane l at p + (l % 2, l / 2)) one
+        // at a time, returning the mask of those that weren't discarded (with their colors set)
+        template <typename FragmentsT>
+        inline int shade_lanes(
+            const FragmentsT &fragments, const Vec2i &p,
+            const Vec3f barycentric_coords[4], int mask, Simd::Color4 &colors
+        ) {
+            alignas(16) float channels[4][4] = {};
+            int shaded = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                const Vec2i lane_p(p.x + (lane & 1), p.y + (lane >> 1));
+                Vec4f color;
+                if ((mask & (1 << lane)) && !fragments.shade(lane_p, barycentric_coords[lane], color)) {
+                    for (int c = 0; c < 4; ++c)
+                        channels[c][lane] = color[c];
+                    shaded |= 1 << lane;
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+                colors.bgra[c] = _mm_load_ps(channels[c]);
+            return shaded;
+        }
+
+        // True iff ShaderT declares QuadVaryings (i.e. its Varyings with Simd::Float4 components),
+        // and a fragment() overload that shades four pixels at once, in SoA form:
+        //     int fragment(const QuadVaryings &interpolated, const Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors)
+        // which only has to shade the lanes in mask, and returns the mask of the discarded ones
+        // obs.: frag_coord is the position of the quad's first lane (see shade_lanes)
+        template <typename ShaderT, typename = void>
+        struct HasQuadFragment : std::false_type { };
+
+        template <typename ShaderT>
+        struct HasQuadFragment<ShaderT, typename Void<typename ShaderT::QuadVaryings>::type> : std::true_type { };
+#endif
+
+        // Inputs of ShaderT's fragment(), set up once per triangle: the plane equations of the
+        // varyings it declares (see Interpolation), which are evaluated at each pixel it shades,
+        // and the state returned by its setup_triangle(), if it has one (see TriangleSetup)
+        // obs.: ShaderT must have a Varyings type, and a const fragment(const Varyings &, const Vec2i &, Vec4f &),
+        //       which is also passed the position of the pixel on the screen, as the shaders in Shaders do,
+        //       and sets the BGRA channels of its color (in [0, 255], but unclamped, as Simd::Color4's)
+        template <typename ShaderT>
+        struct Fragments {
+            // What the fragments of a triangle are set up from (see Draw::triangle)
+            struct Source {
+                const ShaderT *shader;
+                const Interpolation::Triangle<typename ShaderT::Varyings> *triangle;
+                const Mat3f *weights;
+            };
+
+            typedef TriangleSetup<ShaderT> Setup;
+
+            const ShaderT *shader;
+            Interpolation::Planes<typename ShaderT::Varyings> planes;
+            typename Setup::State state;
+
+            Fragments(const Source &source, const Geometry::TriangleEdges &edges, const Vec2i &reference)
+                : shader(source.shader)
+                , planes(edges, reference, *source.triangle, source.weights)
+                , state(Setup::setup(*source.shader, *source.triangle)) { }
+
+            inline bool shade(const Vec2i &p, const Vec3f &barycentric_coords, Vec4f &color) const {
+                return shade(p, color, HasDerivatives<ShaderT>());
+            }
+
+            inline bool shade(const Vec2i &p, Vec4f &color, std::false_type) const {
+                return Setup::fragment(*shader, state, planes.at(p), p, color);
+            }
+
+            inline bool shade(const Vec2i &p, Vec4f &color, std::true_type) const {
+                typename ShaderT::Varyings d_dx, d_dy;
+                planes.derivatives(p, d_dx, d_dy);
+                return Setup::fragment(*shader, state, planes.at(p), d_dx, d_dy, p, color);
+            }
+
+#ifdef DRAW_QUADS
+            // Shades the pixels of the quad at p in mask (see shade_lanes), at once if ShaderT can
+            inline int shade_quad(
+                const Vec2i &p, const Vec3f barycentric_coords[4], int mask, Simd::Color4 &colors
+            ) const {
+                return shade_quad(p, barycentric_coords, mask, colors, HasQuadFragment<ShaderT>());
+            }
+
+            inline int shade_quad(
+                const Vec2i &p, const Vec3f barycentric_coords[4], int mask, Simd::Color4 &colors,
+                std::false_type
+            ) const {
+                return shade_lanes(*this, p, barycentric_coords, mask, colors);
+            }
+
+            inline int shade_quad(
+                const Vec2i &p, const Vec3f barycentric_coords[4], int mask, Simd::Color4 &colors,
+                std::true_type
+            ) const {
+                typedef typename ShaderT::QuadVaryings QuadVaryings;
+                const int discarded = Setup::fragment(*shader, state, planes.template at_quad<QuadVaryings>(p), p, mask, colors);
+                return mask & ~discarded;
+            }
+#endif
+        };
+
+        // The Shader interface is passed barycentric coordinates w.r.t. the original triangle instead,
+        // and keeps its own per-triangle state, which it can set up in setup_triangle()
+        // obs.: shader is null for depth only passes
+        template <>
+        struct Fragments<Shader> {
+            struct Source {
+                Shader *shader;
+                const Mat3f *weights;
+            };
+
+            Shader *shader;
+            const Mat3f *weights;
+
+            Fragments(const Source &source, const Geometry::TriangleEdges &edges, const Vec2i &reference)
+                : shader(source.shader)
+                , weights(source.weights) {
+                if (shader != nullptr)
+                    shader->setup_triangle();
+            }
+
+            inline bool shade(const Vec2i &p, const Vec3f &barycentric_coords, Vec4f &color) const {
+                TGAColor tga_color;
+                const bool discard = shader->fragment(weights ? *weights * barycentric_coords : barycentric_coords, tga_color);
+                color = Vec4f(tga_color[0], tga_color[1], tga_color[2], tga_color[3]);
+                return discard;
+            }
+
+#ifdef DRAW_QUADS
+            inline int shade_quad(
+                const Vec2i &p, const Vec3f barycentric_coords[4], int mask, Simd::Color4 &colors
+            ) const {
+                return shade_lanes(*this, p, barycentric_coords, mask, colors);
+            }
+#endif
+        };
+
+        // Framebuffer written by the rasterization kernels, covering [origin, origin + framebuffer->size())
+        template <typename ShaderT>
+        struct KernelTarget {
+            Frame::Buffer *framebuffer;
+            Vec2i origin;
+            const Fragments<ShaderT> *fragments;
+        };
+
+        // Depth test of a pixel (against its value in the z-buffer)
+        template <DepthTest TEST>
+        inline bool depth_test(float z, float pz) {
+            return TEST == DepthTest::Less ? z < pz : z == pz;
+        }
+
+        // Shades (unless SHADE is false) pixel p, at index i of target's framebuffer, which passed the
+        // coverage and depth tests with depth pz, returning true iff its value in the z-buffer was written
+        template <typename ShaderT, DepthTest TEST, bool SHADE>
+        inline bool shade(
+            const KernelTarget<ShaderT> &target, const Vec2i &p, int i,
+            const Vec3f &barycentric_coords, float pz
+        ) {
+            if (SHADE) {
+                Vec4f color;
+                bool discard = target.fragments->shade(p, barycentric_coords, color); // sets color
+                if (discard)
+                    return false;
+                // obs.: the same as store_quad does for each lane, so the output is identical
+                if (target.framebuffer->format() == Frame::Format::HDR)
+                    target.framebuffer->store_hdr(i, color * (1.0f / 255.0f));
+                else
+                    target.framebuffer->store(i, Frame::pack(color));
+            }
+            if (TEST == DepthTest::Equal)
+                return false; // the depth is already there
+            target.framebuffer->depth()[i] = pz;
+            return true;
+        }
+
+        // Steps the edge functions one pixel at a time, row by row, in the (clamped) bounding box,
+        // returning true iff any depth value was written
+        // obs.: it's only called on rects inside of a single block (see rasterize), so all pixels
+        //       it touches are within the same 4 cache lines of the z-buffer
+        template <typename ShaderT, DepthTest TEST, bool SHADE>
+        bool triangle_pixels(
+            const Geometry::TriangleEdges &edges, const Vec3f &vertex_depths,
+            const Vec2i &bbox_min, const Vec2i &bbox_max, const KernelTarget<ShaderT> &target
+        ) {
+            const Frame::Buffer &framebuffer = *target.framebuffer;
+            const float *depth = framebuffer.depth();
+
+            bool written = false;
+
+            int64_t w_a_row = edges.bc.at(bbox_min);
+            int64_t w_b_row = edges.ca.at(bbox_min);
+            int64_t w_c_row = edges.ab.at(bbox_min);
+
+            Vec2i p;
+            for (p.y = bbox_min.y; p.y <= bbox_max.y; ++p.y) {
+                int64_t w_a = w_a_row;
+                int64_t w_b = w_b_row;
+                int64_t w_c = w_c_row;
+
+                for (p.x = bbox_min.x; p.x <= bbox_max.x; ++p.x) {
+                    if ((w_a | w_b | w_c) >= 0) { // i.e. all weights are non-negative
+                        Vec3f barycentric_coords = edges.barycentric_coords(w_a, w_b, w_c);
+
+                        float pz = Geometry::barycentric_interp(barycentric_coords, vertex_depths);
+                        const int i = framebuffer.index(p - target.origin);
+                        if (depth_test<TEST>(depth[i], pz))
+                            written |= shade<ShaderT, TEST, SHADE>(target, p, i, barycentric_coords, pz);
+                    }
+
+                    // step one pixel along x
+                    w_a += edges.bc.step_x();
+                    w_b += edges.ca.step_x();
+                    w_c += edges.ab.step_x();
+                }
+
+                // step one pixel along y
+                w_a_row += edges.bc.step_y();
+                w_b_row += edges.ca.step_y();
+                w_c_row += edges.ab.step_y();
+            }
+
+            return written;
+        }
+
+#ifdef DRAW_QUADS
+        // Lanes whose bit is set in mask, as all ones (and the others as all zeros), to blend stores with
+        inline __m128i lanes_of(int mask) {
+            const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+            return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), lane_bits), lane_bits);
+        }
+
+        // Writes the colors of the lanes in mask to the quad at index i (a multiple of 4) of framebuffer
+        inline void store_quad(Frame::Buffer &framebuffer, int i, const Simd::Color4 &colors, int mask) {
+            const __m128i write = lanes_of(mask);
+
+            if (framebuffer.format() == Frame::Format::HDR) {
+                const Simd::Float4 inv_255 = _mm_set1_ps(1.0f / 255.0f);
+                float *channels = framebuffer.hdr_color() + Frame::Buffer::hdr_index(i);
+                for (int c = 0; c < 4; ++c) {
+                    float *channel = channels + 4 * c;
+                    _mm_store_ps(channel, Simd::select(
+                        _mm_castsi128_ps(write), _mm_mul_ps(colors.bgra[c], inv_255), _mm_load_ps(channel)
+                    ));
+                }
+                return;
+            }
+
+            // truncate each channel (as converting to TGAColor does), saturating it to [0, 255], and
+            // transpose the quad's 4 x 4 bytes from SoA (i.e. BBBB GGGG RRRR AAAA) to a Pixel per lane
+            const __m128i bg = _mm_packs_epi32(_mm_cvttps_epi32(colors.bgra[0]), _mm_cvttps_epi32(colors.bgra[1]));
+            const __m128i ra = _mm_packs_epi32(_mm_cvttps_epi32(colors.bgra[2]), _mm_cvttps_epi32(colors.bgra[3]));
+            const __m128i bgra = _mm_packus_epi16(bg, ra);
+            const __m128i brga = _mm_unpacklo_epi8(bgra, _mm_srli_si128(bgra, 8)); // i.e. BRBR... GAGA...
+            const __m128i packed = _mm_unpacklo_epi8(brga, _mm_srli_si128(brga, 8));
+
+            __m128i *pixels = reinterpret_cast<__m128i *>(framebuffer.color() + i);
+            _mm_store_si128(pixels, _mm_or_si128(
+                _mm_and_si128(write, packed), _mm_andnot_si128(write, _mm_load_si128(pixels))
+            ));
+        }
+
+        // Steps the edge functions over 2x2 pixel blocks (quads), testing the coverage and depth
+        // of all four pixels at once, with lanes (x, y), (x+1, y), (x, y+1) and (x+1, y+1)
+        // obs.: the barycentric coordinates and depth of each lane are computed with the same
+        //       operations (and in the same order) as in triangle_pixels, so the output is identical
+        // obs.: requires edges.fits_in_32_bits, as the lanes hold 32-bit edge function values
+        // obs.: quads start at even pixels (relative to target.origin), so that the depth values
+        //       (and colors) of their lanes are contiguous in the framebuffer, and loaded at once
+        template <typename ShaderT, DepthTest TEST, bool SHADE>
+        bool triangle_quads(
+            const Geometry::TriangleEdges &edges, const Vec3f &vertex_depths,
+            const Vec2i &bbox_min, const Vec2i &bbox_max, const KernelTarget<ShaderT> &target
+        ) {
+            Frame::Buffer &framebuffer = *target.framebuffer;
+            float *depth = framebuffer.depth();
+
+            // offsets of each lane's edge function value, from the one at the quad's corner
+            const __m128i lane_w_a = _mm_setr_epi32(0, edges.bc.step_x(), edges.bc.step_y(), edges.bc.step_x() + edges.bc.step_y());
+            const __m128i lane_w_b = _mm_setr_epi32(0, edges.ca.step_x(), edges.ca.step_y(), edges.ca.step_x() + edges.ca.step_y());
+            const __m128i lane_w_c = _mm_setr_epi32(0, edges.ab.step_x(), edges.ab.step_y(), edges.ab.step_x() + edges.ab.step_y());
+            const __m128i bias_a = _mm_set1_epi32(edges.bc.bias);
+            const __m128i bias_b = _mm_set1_epi32(edges.ca.bias);
+            const __m128i bias_c = _mm_set1_epi32(edges.ab.bias);
+
+            const __m128i lane_x = _mm_setr_epi32(0, 1, 0, 1);
+            const __m128i lane_y = _mm_setr_epi32(0, 0, 1, 1);
+            const __m128i bbox_min_x = _mm_set1_epi32(bbox_min.x);
+            const __m128i bbox_min_y = _mm_set1_epi32(bbox_min.y);
+            const __m128i bbox_max_x = _mm_set1_epi32(bbox_max.x);
+            const __m128i bbox_max_y = _mm_set1_epi32(bbox_max.y);
+
+            const __m128 inv_area2 = _mm_set1_ps(edges.inv_area2);
+            const __m128 depth_a = _mm_set1_ps(vertex_depths.x);
+            const __m128 depth_b = _mm_set1_ps(vertex_depths.y);
+            const __m128 depth_c = _mm_set1_ps(vertex_depths.z);
+
+            bool written = false;
+
+            const Vec2i quad_min(
+                bbox_min.x - ((bbox_min.x - target.origin.x) & 1),
+                bbox_min.y - ((bbox_min.y - target.origin.y) & 1)
+            );
+
+            int w_a_row = static_cast<int>(edges.bc.at(quad_min));
+            int w_b_row = static_cast<int>(edges.ca.at(quad_min));
+            int w_c_row = static_cast<int>(edges.ab.at(quad_min));
+
+            Vec2i p;
+            for (p.y = quad_min.y; p.y <= bbox_max.y; p.y += 2) {
+                int w_a = w_a_row;
+                int w_b = w_b_row;
+                int w_c = w_c_row;
+
+                // lanes outside of the bounding box on y (i.e. on its first or last row)
+                const __m128i lane_p_y = _mm_add_epi32(_mm_set1_epi32(p.y), lane_y);
+                const __m128i outside_y = _mm_or_si128(
+                    _mm_cmplt_epi32(lane_p_y, bbox_min_y), _mm_cmpgt_epi32(lane_p_y, bbox_max_y)
+                );
+
+                for (p.x = quad_min.x; p.x <= bbox_max.x; p.x += 2) {
+                    const __m128i w_a4 = _mm_add_epi32(_mm_set1_epi32(w_a), lane_w_a);
+                    const __m128i w_b4 = _mm_add_epi32(_mm_set1_epi32(w_b), lane_w_b);
+                    const __m128i w_c4 = _mm_add_epi32(_mm_set1_epi32(w_c), lane_w_c);
+
+                    // all weights are non-negative, and the lane is inside of the bounding box
+                    const __m128i lane_p_x = _mm_add_epi32(_mm_set1_epi32(p.x), lane_x);
+                    const __m128i outside_x = _mm_or_si128(
+                        _mm_cmplt_epi32(lane_p_x, bbox_min_x), _mm_cmpgt_epi32(lane_p_x, bbox_max_x)
+                    );
+                    const __m128i covered = _mm_andnot_si128(
+                        _mm_or_si128(outside_x, outside_y),
+                        _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(w_a4, w_b4), w_c4), _mm_set1_epi32(-1))
+                    );
+
+                    if (_mm_movemask_ps(_mm_castsi128_ps(covered))) {
+                        const __m128 bary_a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(w_a4, bias_a)), inv_area2);
+                        const __m128 bary_b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(w_b4, bias_b)), inv_area2);
+                        const __m128 bary_c = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(w_c4, bias_c)), inv_area2);
+                        const __m128 pz = _mm_add_ps(
+                            _mm_add_ps(_mm_mul_ps(bary_a, depth_a), _mm_mul_ps(bary_b, depth_b)),
+                            _mm_mul_ps(bary_c, depth_c)
+                        );
+
+                        // obs.: lanes past the framebuffer's border read its padding (see Frame::Buffer)
+                        const int i = framebuffer.index(p - target.origin);
+                        const __m128 z = _mm_load_ps(depth + i);
+
+                        const __m128 passed = TEST == DepthTest::Less ? _mm_cmplt_ps(z, pz) : _mm_cmpeq_ps(z, pz);
+                        int mask = _mm_movemask_ps(_mm_and_ps(_mm_castsi128_ps(covered), passed));
+                        if (mask && SHADE) {
+                            alignas(16) float lanes_a[4], lanes_b[4], lanes_c[4];
+                            _mm_store_ps(lanes_a, bary_a);
+                            _mm_store_ps(lanes_b, bary_b);
+                            _mm_store_ps(lanes_c, bary_c);
+                            const Vec3f barycentric_coords[4] = {
+                                Vec3f(lanes_a[0], lanes_b[0], lanes_c[0]), Vec3f(lanes_a[1], lanes_b[1], lanes_c[1]),
+                                Vec3f(lanes_a[2], lanes_b[2], lanes_c[2]), Vec3f(lanes_a[3], lanes_b[3], lanes_c[3])
+                            };
+
+                            // only shade the lanes that passed both the coverage and depth tests,
+                            // and then only write the ones that weren't discarded
+                            Simd::Color4 colors;
+                            mask = target.fragments->shade_quad(p, barycentric_coords, mask, colors);
+                            if (mask)
+                                store_quad(framebuffer, i, colors, mask);
+                        }
+                        if (mask && TEST == DepthTest::Less) {
+                            const __m128 write = _mm_castsi128_ps(lanes_of(mask));
+                            _mm_store_ps(depth + i, _mm_or_ps(_mm_and_ps(write, pz), _mm_andnot_ps(write, z)));
+                            written = true;
+                        }
+                    }
+
+                    // step one quad along x
+                    w_a += 2 * edges.bc.step_x();
+                    w_b += 2 * edges.ca.step_x();
+                    w_c += 2 * edges.ab.step_x();
+                }
+
+                // step one quad along y
+                w_a_row += 2 * edges.bc.step_y();
+                w_b_row += 2 * edges.ca.step_y();
+                w_c_row += 2 * edges.ab.step_y();
+            }
+
+            return written;
+        }
+#endif
+
+        // Rasterizes the pixels in [rect_min, rect_max] with the best kernel for the triangle
+        template <typename ShaderT, DepthTest TEST, bool SHADE>
+        bool triangle_rect(
+            const Geometry::TriangleEdges &edges, const Vec3f &vertex_depths,
+            const Vec2i &rect_min, const Vec2i &rect_max, const KernelTarget<ShaderT> &target
+        ) {
+#ifdef DRAW_QUADS
+            if (edges.fits_in_32_bits)
+                return triangle_quads<ShaderT, TEST, SHADE>(edges, vertex_depths, rect_min, rect_max, target);
+#endif
+            return triangle_pixels<ShaderT, TEST, SHADE>(edges, vertex_depths, rect_min, rect_max, target);
+        }
+
+        // Sets up the triangle (unless setup, its edges, isn't null) and rasterizes it into framebuffer
+        // (with its (0, 0) pixel at origin), one block at a time (following its layout), using hiz
+        // (if not null) to skip hidden parts
+        // obs.: source is as in Draw::triangle, but its shader is null iff SHADE is false
+        // obs.: framebuffer must have a color buffer (i.e. not be Frame::Format::Depth) if SHADE is true
+        template <typename ShaderT, DepthTest TEST, bool SHADE>
+        void rasterize(
+            const TriangleProps<Vec3f> &pos, const typename Fragments<ShaderT>::Source &source,
+            Frame::Buffer &framebuffer, const Vec2i &origin, HiZ::Pyramid *hiz,
+            const Geometry::TriangleEdges *setup
+        ) {
+            // set up the edge functions once, and step them across the bounding box
+            assert(!SHADE || framebuffer.format() != Frame::Format::Depth);
+
+            Geometry::TriangleEdges triangle_edges;
+            if (setup == nullptr) {
+                triangle_edges = Geometry::TriangleEdges(Geometry::TriangleXY<float>(pos.a, pos.b, pos.c));
+                setup = &triangle_edges;
+            }
+            const Geometry::TriangleEdges &edges = *setup;
+            if (!edges.is_in_guard_band || edges.is_degenerate)
+                return;
+
+            const Vec2i &size = framebuffer.size();
+            const Vec2i bbox_min = Vec2i(
+                std::max(origin.x, edges.bbox_min.x),
+                std::max(origin.y, edges.bbox_min.y)
+            ); // max(origin, min(a, b, c))
+
+            const Vec2i bbox_max = Vec2i(
+                std::min(edges.bbox_max.x, origin.x + size.x - 1),
+                std::min(edges.bbox_max.y, origin.y + size.y - 1)
+            ); // min(max(a, b, c), origin + {width, height})
+
+            if (bbox_min.x > bbox_max.x || bbox_min.y > bbox_max.y)
+                return; // no pixel centers are covered
+
+            const Vec3f vertex_depths(pos.a.z, pos.b.z, pos.c.z);
+
+            // skip the triangle if it's behind everything in its bounding box
+            // obs.: with DepthTest::Equal, it can still pass where its depth equals the farthest one,
+            //       so it's only hidden if the farthest depth is greater than (i.e. >= the next float)
+            float closest_depth = Math::max(pos.a.z, pos.b.z, pos.c.z);
+            if (TEST == DepthTest::Equal)
+                closest_depth = std::nextafter(closest_depth, Math::MAX_FLOAT);
+            if (hiz != nullptr && hiz->is_occluded(bbox_min - origin, bbox_max - origin, closest_depth))
+                return;
+
+            // set up the fragment shader's inputs only for (at least partially) visible triangles
+            // obs.: the planes are evaluated from the triangle's (unclamped) bounding box, and not from the
+            //       part of it in framebuffer, so that the values don't depend on the tiles it's drawn in
+            const Fragments<ShaderT> fragments(source, edges, edges.bbox_min);
+            const KernelTarget<ShaderT> target = { &framebuffer, origin, &fragments };
+
+            // rasterize each block that the bounding box overlaps,
+            // unless the triangle is behind everything in it
+            const Vec2i block_min((bbox_min.x - origin.x) / Frame::BLOCK_SIZE, (bbox_min.y - origin.y) / Frame::BLOCK_SIZE);
+            const Vec2i block_max((bbox_max.x - origin.x) / Frame::BLOCK_SIZE, (bbox_max.y - origin.y) / Frame::BLOCK_SIZE);
+            Vec2i block;
+            for (block.y = block_min.y; block.y <= block_max.y; ++block.y) {
+                for (block.x = block_min.x; block.x <= block_max.x; ++block.x) {
+                    if (hiz != nullptr && hiz->block_depth(block) >= closest_depth)
+                        continue;
+
+                    const Vec2i rect_min(
+                        std::max(bbox_min.x, origin.x + block.x * Frame::BLOCK_SIZE),
+                        std::max(bbox_min.y, origin.y + block.y * Frame::BLOCK_SIZE)
+                    );
+                    const Vec2i rect_max(
+                        std::min(bbox_max.x, origin.x + (block.x + 1) * Frame::BLOCK_SIZE - 1),
+                        std::min(bbox_max.y, origin.y + (block.y + 1) * Frame::BLOCK_SIZE - 1)
+                    );
+                    if (triangle_rect<ShaderT, TEST, SHADE>(edges, vertex_depths, rect_min, rect_max, target) && hiz != nullptr)
+                        hiz->update(framebuffer.block_depth(block), block);
+                }
+            }
+        }
+    }
+
+    template <typename ShaderT>
+    void triangle(TriangleProps<Types::Vec3f> pos, const ShaderT &shader,
+                  const Interpolation::Triangle<typename ShaderT::Varyings> &triangle,
+                  Frame::Buffer &framebuffer,
+                  Types::Vec2i origin, HiZ::Pyramid *hiz, DepthTest depth_test,
+                  const Types::Mat3f *weights, const Geometry::TriangleEdges *edges) {
+        const typename Kernels::Fragments<ShaderT>::Source source = { &shader, &triangle, weights };
+        if (depth_test == DepthTest::Less)
+            Kernels::rasterize<ShaderT, DepthTest::Less, true>(pos, source, framebuffer, origin, hiz, edges);
+        else
+            Kernels::rasterize<ShaderT, DepthTest::Equal, true>(pos, source, framebuffer, origin, hiz, edges);
+    }
 }
 
 #endif // __DRAW_HH__
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "Frame.hh"
+
+#include <cstdint>
+#include <algorithm>
+
+#include "Math.hh"
+
+using Types::Vec2i;
+
+namespace Frame {
+
+    ///////////////////////////////////////////////////////
+    /// Buffer ////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Offset of the first element of data that's aligned to a cache line
+    // obs.: data must be over-allocated by a cache line, so that it's followed by enough elements
+    template <typename T>
+    static int cache_line_offset(const std::vector<T> &data) {
+        static_assert(CACHE_LINE % sizeof(T) == 0, "elements must not straddle cache lines");
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data.data());
+        return static_cast<int>((CACHE_LINE - address % CACHE_LINE) % CACHE_LINE / sizeof(T));
+    }
+
+    const unsigned char Buffer::MORTON_BITS[BLOCK_SIZE] = {
+        0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15 // 0b000 -> 0b000000, ..., 0b111 -> 0b010101
+    };
+
+    Buffer::Buffer(const Vec2i &size, Format format)
+        : _size(size)
+        , _n_blocks((size.x + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                    (size.y + BLOCK_SIZE - 1) / BLOCK_SIZE)
+        , _format(format)
+        // over-allocate a cache line, to align the first block to one
+        , _color(format == Format::LDR ? _n_blocks.x * _n_blocks.y * BLOCK_PIXELS + CACHE_LINE / sizeof(Pixel) : 0)
+        , _hdr_color(format == Format::HDR ? 4 * _n_blocks.x * _n_blocks.y * BLOCK_PIXELS + CACHE_LINE / sizeof(float) : 0)
+        , _depth(_n_blocks.x * _n_blocks.y * BLOCK_PIXELS + CACHE_LINE / sizeof(float))
+        , _color_offset(cache_line_offset(_color))
+        , _hdr_color_offset(cache_line_offset(_hdr_color))
+        , _depth_offset(cache_line_offset(_depth)) {
+        clear();
+    }
+
+    void Buffer::clear() {
+        std::fill(_color.begin(), _color.end(), 0);
+        std::fill(_hdr_color.begin(), _hdr_color.end(), 0.0f);
+        std::fill(_depth.begin(), _depth.end(), Math::MIN_FLOAT);
+
+        // obs.: only blocks on the right and top borders have padding
+        Vec2i p;
+        for (p.y = 0; p.y < _n_blocks.y * BLOCK_SIZE; ++p.y)
+            for (p.x = _size.x; p.x < _n_blocks.x * BLOCK_SIZE; ++p.x)
+                depth()[index(p)] = Math::MAX_FLOAT;
+        for (p.y = _size.y; p.y < _n_blocks.y * BLOCK_SIZE; ++p.y)
+            for (p.x = 0; p.x < _size.x; ++p.x)
+                depth()[index(p)] = Math::MAX_FLOAT;
+    }
+
+    void Buffer::resolve(TGAImage &image, const Vec2i &origin) const {
+        const int bytespp = image.get_bytespp();
+        assert(_format == Format::LDR);
+        assert(bytespp >= 1 && bytespp <= 4);
+        assert(origin.x + _size.x <= image.get_width() && origin.y + _size.y <= image.get_height());
+
+        unsigned char *data = image.buffer();
+        const int width = image.get_width();
+        Vec2i p;
+        for (p.y = 0; p.y < _size.y; ++p.y) {
+            unsigned char *row = data + (origin.x + (origin.y + p.y) * width) * bytespp;
+            for (p.x = 0; p.x < _size.x; ++p.x) {
+                const Pixel pixel = load(index(p));
+                for (int c = 0; c < bytespp; ++c)
+                    row[p.x * bytespp + c] = static_cast<unsigned char>(pixel >> (8 * c));
+            }
+        }
+    }
+
+    void Buffer::resolve_hdr(float *bgra, int stride, const Vec2i &origin) const {
+        assert(_format == Format::HDR);
+
+        Vec2i p;
+        for (p.y = 0; p.y < _size.y; ++p.y) {
+            float *row = bgra + 4 * (origin.x + (origin.y + p.y) * stride);
+            for (p.x = 0; p.x < _size.x; ++p.x) {
+                const float *channels = hdr_color() + hdr_index(index(p));
+                for (int c = 0; c < 4; ++c)
+                    row[4 * p.x + c] = channels[4 * c];
+            }
+        }
+    }
+
+    void Buffer::resolve_depth(float *depth, int stride, const Vec2i &origin) const {
+        Vec2i p;
+        for (p.y = 0; p.y < _size.y; ++p.y) {
+            float *row = depth + origin.x + (origin.y + p.y) * stride;
+            for (p.x = 0; p.x < _size.x; ++p.x)
+                row[p.x] = _depth[_depth_offset + index(p)];
+        }
+    }
+}
\ No newline at end of file
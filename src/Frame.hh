@@ -0,0 +1,156 @@
+#ifndef __FRAME_HH__
+#define __FRAME_HH__
+
+#include <vector>
+#include <cstdint>
+
+#include "tgaimage.hh"
+
+#include "HiZ.hh"
+#include "Types.hh"
+
+namespace Frame {
+
+    // Pixels are stored in BLOCK_SIZE x BLOCK_SIZE blocks (the same as HiZ's), in row-major order,
+    // and in Morton (Z) order inside of each block, so that a block of depth values takes 256B
+    // (i.e. 4 cache lines), and each 2x2 pixel quad (with even x and y) is contiguous in memory
+    static const int BLOCK_SIZE = HiZ::BLOCK_SIZE;
+    static const int BLOCK_PIXELS = BLOCK_SIZE * BLOCK_SIZE;
+    static const int CACHE_LINE = 64; // bytes
+
+    ///////////////////////////////////////////////////////
+    /// Pixel /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Color of a pixel, with its 4 channels packed into 32 bits, in TGAColor's BGRA order from the least
+    // significant byte (i.e. the same bytes as TGAColor::bgra, and a 32-bit TGA file, on little endian)
+    typedef uint32_t Pixel;
+    static_assert(sizeof(Pixel) == sizeof(TGAColor::bgra), "a Pixel must hold exactly TGAColor's 4 channels");
+
+    inline Pixel pack(const TGAColor &color) {
+        return static_cast<Pixel>(color.bgra[0])
+             | static_cast<Pixel>(color.bgra[1]) << 8
+             | static_cast<Pixel>(color.bgra[2]) << 16
+             | static_cast<Pixel>(color.bgra[3]) << 24;
+    }
+
+    // Same as above, for channels in floats, which are truncated (as converting them to TGAColor's does),
+    // and saturated to [0, 255] (as Draw::Kernels::store_quad does), so NaNs are written as 0
+    inline Pixel pack(const Types::Vec4f &bgra) {
+        Pixel pixel = 0;
+        for (int c = 0; c < 4; ++c) {
+            const Pixel channel = bgra[c] >= 255.0f ? 255 : (bgra[c] > 0.0f ? static_cast<Pixel>(bgra[c]) : 0);
+            pixel |= channel << (8 * c);
+        }
+        return pixel;
+    }
+
+    inline TGAColor unpack(Pixel pixel) {
+        return TGAColor(pixel >> 16, pixel >> 8, pixel, pixel >> 24); // obs.: TGAColor takes RGBA
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Buffer ////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // How the color buffer stores each pixel's BGRA channels
+    enum class Format {
+        LDR, // as a Pixel, i.e. 8 bits per channel, in [0, 255]
+        HDR, // as floats, in [0, 1] where a Pixel would be, but unclamped, which are tone mapped afterwards
+        Depth, // not at all, i.e. there's only a depth buffer, for depth only passes (see Draw::triangle_depth)
+    };
+
+    // Color and depth buffers, in the blocked layout above
+    // obs.: LDR colors are always 4 channel Pixels, whatever the image they're resolved to, so that each
+    //       quad's colors are also a single (aligned) SIMD store, and they're only converted in resolve()
+    // obs.: HDR colors are stored in SoA form per quad (i.e. the B of its 4 pixels, then their G, ...),
+    //       so that each of a quad's channels is also a single (aligned) SIMD store (see hdr_index)
+    // obs.: the buffers are padded to a whole number of blocks, and the depth of pixels
+    //       in the padding is kept at MAX_FLOAT, so that they never hide anything (in HiZ)
+    // obs.: each buffer starts at a cache line, so that quads are aligned, and blocks never straddle
+    //       more cache lines than they take (their storage is over-allocated to align it)
+    class Buffer {
+        private:
+            Types::Vec2i _size;
+            Types::Vec2i _n_blocks; // number of block columns and rows
+            Format _format;
+
+            std::vector<Pixel> _color; // obs.: only one of the color buffers is allocated, by _format
+            std::vector<float> _hdr_color;
+            std::vector<float> _depth;
+            int _color_offset; // of the first (cache line aligned) element of each buffer in its storage
+            int _hdr_color_offset;
+            int _depth_offset;
+
+            // Bits of a coordinate inside of a block, spread to the even bits of its Morton code
+            static const unsigned char MORTON_BITS[BLOCK_SIZE];
+
+        public:
+            explicit Buffer(const Types::Vec2i &size, Format format = Format::LDR);
+
+            // obs.: it's only moved, as a copy of the storage may not be aligned the same way
+            Buffer(const Buffer &) = delete;
+            Buffer &operator=(const Buffer &) = delete;
+            Buffer(Buffer &&) = default;
+            Buffer &operator=(Buffer &&) = default;
+
+            const Types::Vec2i &size() const { return _size; }
+            Format format() const { return _format; }
+
+            // Resets the color of all pixels to black, and their depth to MIN_FLOAT
+            void clear();
+
+            // Position of pixel p in the buffers
+            inline int index(const Types::Vec2i &p) const {
+                const int block = (p.x / BLOCK_SIZE) + (p.y / BLOCK_SIZE) * _n_blocks.x;
+                return block * BLOCK_PIXELS
+                     + (MORTON_BITS[p.x % BLOCK_SIZE] | (MORTON_BITS[p.y % BLOCK_SIZE] << 1));
+            }
+
+            inline Pixel *color() { return _color.data() + _color_offset; }
+            inline const Pixel *color() const { return _color.data() + _color_offset; }
+
+            inline float *hdr_color() { return _hdr_color.data() + _hdr_color_offset; }
+            inline const float *hdr_color() const { return _hdr_color.data() + _hdr_color_offset; }
+
+            // Position of the B channel of the pixel at index in hdr_color(), with its G, R and A channels
+            // at the following multiples of 4 (i.e. in the next SIMD lanes of its quad)
+            static inline int hdr_index(int index) {
+                return 4 * (index & ~3) + (index & 3);
+            }
+
+            inline float *depth() { return _depth.data() + _depth_offset; }
+            inline const float *depth() const { return _depth.data() + _depth_offset; }
+
+            // Depth values of block [block * BLOCK_SIZE, (block + 1) * BLOCK_SIZE), in Morton order
+            inline const float *block_depth(const Types::Vec2i &block) const {
+                return depth() + (block.x + block.y * _n_blocks.x) * BLOCK_PIXELS;
+            }
+
+            // obs.: index isn't checked, as the rasterizer only visits pixels inside of the buffer
+            inline void store(int index, Pixel pixel) { color()[index] = pixel; }
+            inline Pixel load(int index) const { return color()[index]; }
+
+            inline void store_hdr(int index, const Types::Vec4f &bgra) {
+                float *channels = hdr_color() + hdr_index(index);
+                for (int c = 0; c < 4; ++c)
+                    channels[4 * c] = bgra[c];
+            }
+
+            // Copies the color buffer into image (in its linear, row-major, layout), with the buffer's
+            // (0, 0) pixel at origin, keeping the first image.get_bytespp() channels of each pixel
+            // obs.: i.e. grayscale images get the B channel, and RGB ones drop the alpha
+            // obs.: requires an LDR buffer, as HDR ones are tone mapped from resolve_hdr's copy instead
+            void resolve(TGAImage &image, const Types::Vec2i &origin = Types::Vec2i(0, 0)) const;
+
+            // Copies the HDR color buffer into bgra (in a linear, row-major, layout with stride pixels of 4
+            // channels per row), with the buffer's (0, 0) pixel's B channel at bgra[4 * (origin.x + origin.y * stride)]
+            void resolve_hdr(float *bgra, int stride, const Types::Vec2i &origin = Types::Vec2i(0, 0)) const;
+
+            // Copies the depth buffer into depth (in a linear, row-major, layout with stride values
+            // per row), with the buffer's (0, 0) pixel at depth[origin.x + origin.y * stride]
+            void resolve_depth(float *depth, int stride, const Types::Vec2i &origin = Types::Vec2i(0, 0)) const;
+    };
+}
+
+#endif // __FRAME_HH__
\ No newline at end of file
@@ -37,4 +37,89 @@ namespace Geometry {
                                    point.barycentric_coords.z >= 0;
         return point;
     }
+
+    // Snaps a screen position to 28.4 fixed point
+    static Vec2i to_fixed_point(const Vec2f &p) {
+        return Vec2i(
+            static_cast<int>(std::lround(p.x * SUBPIXEL_STEPS)),
+            static_cast<int>(std::lround(p.y * SUBPIXEL_STEPS))
+        );
+    }
+
+    static bool is_in_guard_band(const Vec2f &p) {
+        // obs.: written so that NaNs are outside of it
+        return p.x >= -GUARD_BAND && p.x <= GUARD_BAND &&
+               p.y >= -GUARD_BAND && p.y <= GUARD_BAND;
+    }
+
+    TriangleEdges::TriangleEdges(const TriangleXY<float> &triangle)
+        : bc()
+        , ca()
+        , ab()
+        , bbox_min()
+        , bbox_max()
+        , area2(0)
+        , inv_area2(0)
+        , is_in_guard_band(Geometry::is_in_guard_band(triangle.a) &&
+                           Geometry::is_in_guard_band(triangle.b) &&
+                           Geometry::is_in_guard_band(triangle.c))
+        , is_degenerate(true)
+        , is_clockwise(false)
+        , fits_in_32_bits(false) {
+        if (!is_in_guard_band)
+            return;
+
+        const Vec2i a = to_fixed_point(triangle.a);
+        const Vec2i b = to_fixed_point(triangle.b);
+        const Vec2i c = to_fixed_point(triangle.c);
+
+        bc = EdgeFunction(b, c);
+        ca = EdgeFunction(c, a);
+        ab = EdgeFunction(a, b);
+
+        area2 = int64_t(b.x - a.x) * (c.y - a.y) - int64_t(b.y - a.y) * (c.x - a.x); // E_ab(c)
+        is_degenerate = area2 == 0;
+        if (is_degenerate)
+            return;
+
+        is_clockwise = area2 < 0;
+        if (is_clockwise) {
+            // flip the edges' orientation (i.e. make the triangle counter-clockwise)
+            for (EdgeFunction *e : { &bc, &ca, &ab }) {
+                e->A = -e->A;
+                e->B = -e->B;
+                e->C = -e->C;
+            }
+            area2 = -area2;
+        }
+        inv_area2 = 1.0f / area2;
+
+        for (EdgeFunction *e : { &bc, &ca, &ab }) {
+            // (A, B) points to the inside of the triangle, so it's a top edge
+            // if it's horizontal with B < 0, and a left edge if A > 0
+            bool is_top_left = e->A > 0 || (e->A == 0 && e->B < 0);
+            if (!is_top_left) {
+                e->bias = 1;
+                e->C -= 1; // i.e. E(p) == 0 is outside
+            }
+        }
+
+        // pixels whose centers, (x * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2), lie in [min, max]
+        const Vec2i min(Math::min(a.x, b.x, c.x), Math::min(a.y, b.y, c.y));
+        const Vec2i max(Math::max(a.x, b.x, c.x), Math::max(a.y, b.y, c.y));
+        bbox_min = Vec2i(
+            (min.x - SUBPIXEL_STEPS / 2 + SUBPIXEL_STEPS - 1) >> SUBPIXEL_BITS, // ceil
+            (min.y - SUBPIXEL_STEPS / 2 + SUBPIXEL_STEPS - 1) >> SUBPIXEL_BITS
+        );
+        bbox_max = Vec2i(
+            (max.x - SUBPIXEL_STEPS / 2) >> SUBPIXEL_BITS, // floor
+            (max.y - SUBPIXEL_STEPS / 2) >> SUBPIXEL_BITS
+        );
+
+        // |E(p)| <= |to - from| * |p - from| <= extent.x^2 + extent.y^2,
+        // where extent also accounts for stepping past the bounding box
+        const int64_t extent_x = max.x - min.x + 4 * SUBPIXEL_STEPS;
+        const int64_t extent_y = max.y - min.y + 4 * SUBPIXEL_STEPS;
+        fits_in_32_bits = extent_x * extent_x + extent_y * extent_y < std::numeric_limits<int>::max();
+    }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef __GEOMETRY_HH__
 #define __GEOMETRY_HH__
 
+#include <cstdint>
+
 #include "Math.hh"
 #include "Types.hh"
 
@@ -37,6 +39,83 @@ namespace Geometry {
         const TriangleXY<int> &triangle
     );
 
+    ///////////////////////////////////////////////////////
+    /// edge functions ////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Screen positions are snapped to 28.4 fixed point before rasterization,
+    // and pixels are sampled at their centers, i.e. at (x + 0.5, y + 0.5)
+    static const int SUBPIXEL_BITS = 4;
+    static const int SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS; // per pixel, on each axis
+
+    // Triangles with a vertex farther than GUARD_BAND pixels from the origin aren't rasterized
+    // (they should be clipped before), which bounds the fixed point values so that:
+    //  - positions, and the edges' A and B coefficients (differences of them), fit in 32 bits
+    //  - edge functions, |E(p)| <= |to - from| * |p - from| < 2^43, fit in 64 bits
+    static const float GUARD_BAND = 65536.0f;
+
+    // obs.: E(p) = A * p.x + B * p.y + C is zero on the line through the edge,
+    //       and its sign tells us on which side of it the point p lies
+    struct EdgeFunction {
+        int A, B;  // in 28.4 fixed point
+        int64_t C; // in 56.8 fixed point, as are the values of E(p)
+        int bias;  // 1 iff the edge isn't a top or left one (and C was decremented), 0 otherwise
+
+        EdgeFunction() = default;
+
+        // E(p) = cross(to - from, p - from), with from and to in 28.4 fixed point
+        EdgeFunction(const Types::Vec2i &from, const Types::Vec2i &to)
+            : A(from.y - to.y)
+            , B(to.x - from.x)
+            , C(int64_t(from.x) * to.y - int64_t(from.y) * to.x)
+            , bias(0) { }
+
+        // Value at the center of pixel p
+        inline int64_t at(const Types::Vec2i &p) const {
+            return int64_t(A) * (p.x * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2) +
+                   int64_t(B) * (p.y * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2) + C;
+        }
+
+        // Increments of E(p) when stepping one pixel along x and y
+        inline int step_x() const { return A * SUBPIXEL_STEPS; }
+        inline int step_y() const { return B * SUBPIXEL_STEPS; }
+    };
+
+    // Edge functions of a triangle, set up once so that the (unnormalized)
+    // barycentric coordinates of each pixel can be found incrementally
+    struct TriangleEdges {
+        EdgeFunction bc; // weight of a, i.e. E_bc(a) = area2
+        EdgeFunction ca; // weight of b, i.e. E_ca(b) = area2
+        EdgeFunction ab; // weight of c, i.e. E_ab(c) = area2
+
+        // pixels whose centers are inside of the triangle's bounding box (not clamped to the screen)
+        Types::Vec2i bbox_min;
+        Types::Vec2i bbox_max;
+
+        int64_t area2; // twice the triangle's area (in 56.8 fixed point)
+        float inv_area2;
+
+        bool is_in_guard_band; // true iff all vertices are inside of [-GUARD_BAND, GUARD_BAND]
+        bool is_degenerate;    // true iff area2 == 0
+        bool is_clockwise;     // true iff a, b and c are in clockwise order on screen (with y up)
+        bool fits_in_32_bits;  // true iff edge function values in (and 2 pixels around) bbox fit in an int
+
+        // obs.: the edges are flipped for clockwise triangles, so that all weights are
+        //       non-negative iff a point is inside the triangle, and they are biased following
+        //       a top-left fill rule, so that pixels on an edge shared by two triangles are only
+        //       covered by one of them (i.e. a pixel is inside if it's on a top or left edge)
+        TriangleEdges(const TriangleXY<float> &triangle);
+
+        TriangleEdges() = default; // obs.: uninitialized, until one set up from a triangle is assigned to it
+
+        // (1-u-v, u, v), given the (biased) weights E_bc(p), E_ca(p) and E_ab(p)
+        inline Types::Vec3f barycentric_coords(int64_t w_a, int64_t w_b, int64_t w_c) const {
+            return Types::Vec3f((w_a + bc.bias) * inv_area2,
+                                (w_b + ca.bias) * inv_area2,
+                                (w_c + ab.bias) * inv_area2);
+        }
+    };
+
     ///////////////////////////////////////////////////////
     /// barycentric interpolation /////////////////////////
     ///////////////////////////////////////////////////////
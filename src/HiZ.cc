@@ -0,0 +1,81 @@
+#include "HiZ.hh"
+
+#include <algorithm>
+
+#include "Math.hh"
+
+using Types::Vec2i;
+
+namespace HiZ {
+
+    ///////////////////////////////////////////////////////
+    /// Pyramid ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Pyramid::Pyramid(const Vec2i &resolution)
+        : _sizes()
+        , _levels() {
+        Vec2i size((resolution.x + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                   (resolution.y + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        for (;;) {
+            _sizes.push_back(size);
+            _levels.push_back(std::vector<float>(size.x * size.y, Math::MIN_FLOAT));
+            if (size.x == 1 && size.y == 1)
+                break;
+            size = Vec2i((size.x + 1) / 2, (size.y + 1) / 2);
+        }
+    }
+
+    void Pyramid::clear() {
+        for (std::vector<float> &level : _levels)
+            std::fill(level.begin(), level.end(), Math::MIN_FLOAT);
+    }
+
+    bool Pyramid::is_occluded(Vec2i min, Vec2i max, float depth) const {
+        // find the finest level on which [min, max] overlaps at most 2x2 cells
+        min = Vec2i(min.x / BLOCK_SIZE, min.y / BLOCK_SIZE);
+        max = Vec2i(max.x / BLOCK_SIZE, max.y / BLOCK_SIZE);
+        unsigned int level = 0;
+        while (level + 1 < _levels.size() && (max.x - min.x > 1 || max.y - min.y > 1)) {
+            min = Vec2i(min.x / 2, min.y / 2);
+            max = Vec2i(max.x / 2, max.y / 2);
+            ++level;
+        }
+
+        const std::vector<float> &cells = _levels[level];
+        const int width = _sizes[level].x;
+        for (int y = min.y; y <= max.y; ++y)
+            for (int x = min.x; x <= max.x; ++x)
+                if (cells[x + y * width] < depth)
+                    return false; // might pass the depth test in this cell
+        return true;
+    }
+
+    void Pyramid::update(const float block_depth[], const Vec2i &block) {
+        float farthest = Math::MAX_FLOAT;
+        for (int i = 0; i < BLOCK_SIZE * BLOCK_SIZE; ++i)
+            farthest = std::min(farthest, block_depth[i]);
+
+        Vec2i cell = block;
+        if (_levels[0][cell.x + cell.y * _sizes[0].x] == farthest)
+            return;
+        _levels[0][cell.x + cell.y * _sizes[0].x] = farthest;
+
+        // propagate the change to the coarser levels
+        for (unsigned int level = 1; level < _levels.size(); ++level) {
+            const std::vector<float> &children = _levels[level - 1];
+            const Vec2i &children_size = _sizes[level - 1];
+            cell = Vec2i(cell.x / 2, cell.y / 2);
+
+            farthest = Math::MAX_FLOAT;
+            for (int y = 2 * cell.y; y < std::min(2 * cell.y + 2, children_size.y); ++y)
+                for (int x = 2 * cell.x; x < std::min(2 * cell.x + 2, children_size.x); ++x)
+                    farthest = std::min(farthest, children[x + y * children_size.x]);
+
+            float &parent = _levels[level][cell.x + cell.y * _sizes[level].x];
+            if (parent == farthest)
+                return; // so the levels above don't change either
+            parent = farthest;
+        }
+    }
+}
\ No newline at end of file
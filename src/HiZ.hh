@@ -0,0 +1,47 @@
+#ifndef __HIZ_HH__
+#define __HIZ_HH__
+
+#include <vector>
+
+#include "Types.hh"
+
+namespace HiZ {
+
+    static const int BLOCK_SIZE = 8; // in pixels, of the finest level cells
+
+    ///////////////////////////////////////////////////////
+    /// Pyramid ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Hierarchical z-buffer, keeping the farthest (i.e. minimum) depth of each
+    // BLOCK_SIZE x BLOCK_SIZE block of pixels, and of each 2x2 cells of the level below
+    // obs.: as the depth test passes when z_buffer[p] < depth, anything with a depth
+    //       that isn't greater than the farthest one of the pixels it covers is hidden
+    class Pyramid {
+        private:
+            std::vector<Types::Vec2i> _sizes; // number of cells on each level
+            std::vector<std::vector<float>> _levels;
+
+        public:
+            Pyramid(const Types::Vec2i &resolution);
+
+            // Resets all cells to MIN_FLOAT (i.e. an empty z-buffer)
+            void clear();
+
+            // Farthest depth in the block of pixels [block * BLOCK_SIZE, (block + 1) * BLOCK_SIZE)
+            inline float block_depth(const Types::Vec2i &block) const {
+                return _levels[0][block.x + block.y * _sizes[0].x];
+            }
+
+            // Returns true iff something with the given (closest) depth, spanning
+            // the pixels in [min, max], would fail the depth test on all of them
+            bool is_occluded(Types::Vec2i min, Types::Vec2i max, float depth) const;
+
+            // Recomputes the farthest depth of block (and of the cells above it) from the
+            // depth values of its BLOCK_SIZE x BLOCK_SIZE pixels (e.g. Frame::Buffer::block_depth)
+            // obs.: must be called whenever depth values in the block are written
+            void update(const float block_depth[], const Types::Vec2i &block);
+    };
+}
+
+#endif // __HIZ_HH__
\ No newline at end of file
@@ -0,0 +1,176 @@
+#ifndef __INTERPOLATION_HH__
+#define __INTERPOLATION_HH__
+
+#include "Simd.hh"
+#include "Types.hh"
+#include "Geometry.hh"
+
+namespace Interpolation {
+
+    // Shaders declare their varyings once, as a struct V with only float members (which may be
+    // vectors of them, e.g. Types::Vec3f), and the pipeline interpolates each of its components
+    // obs.: interpolation is perspective correct, i.e. v / w and 1 / w are linear in screen space
+    //       (v itself isn't), so they're interpolated instead, and divided at each pixel
+
+    template <typename V>
+    struct Layout {
+        static const int N_FLOATS = sizeof(V) / sizeof(float);
+        static_assert(sizeof(V) == N_FLOATS * sizeof(float), "varyings must only have float members");
+
+        static inline const float *floats(const V &varyings) { return reinterpret_cast<const float *>(&varyings); }
+        static inline float *floats(V &varyings) { return reinterpret_cast<float *>(&varyings); }
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Triangle //////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Varyings and clip space coordinates of the vertices of a triangle, as assembled from the
+    // vertex shader's outputs (see PostTransform::Buffer::assemble)
+    // obs.: it's owned by the pipeline (e.g. by each thread drawing triangles), and not by the
+    //       shader, so that a single shader (i.e. its uniforms) can be shared by all threads
+    template <typename V>
+    struct Triangle {
+        V varyings[3];
+        Types::Vec4f clip_coords[3];
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Planes ////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Plane equations (in screen space) of each component of the varyings of a triangle divided by w,
+    // and of 1 / w, so that setting them up is done once per triangle, and evaluating them at a pixel
+    // only takes two multiply-adds per component (plus a division by the interpolated 1 / w)
+    template <typename V>
+    class Planes {
+        private:
+            static const int N = Layout<V>::N_FLOATS + 1; // the last component is 1 / w
+
+            Types::Vec2i _reference; // pixel from which the planes are evaluated, to keep offsets small
+            float _value[N]; // at _reference
+            float _d_dx[N];  // increment when stepping one pixel along x
+            float _d_dy[N];  // increment when stepping one pixel along y
+
+#ifdef __SSE2__
+            inline Simd::Float4 evaluate(int k, Simd::Float4 dx, Simd::Float4 dy) const {
+                return _mm_add_ps(
+                    _mm_add_ps(_mm_set1_ps(_value[k]), _mm_mul_ps(_mm_set1_ps(_d_dx[k]), dx)),
+                    _mm_mul_ps(_mm_set1_ps(_d_dy[k]), dy)
+                );
+            }
+#endif
+
+        public:
+            // Sets up the planes of the triangle with edges, given its vertices' varyings (and clip
+            // space coordinates) in triangle, or, if weights isn't null, the original triangle's
+            // it was clipped from (with weights as in Clipping::Triangle)
+            Planes(
+                const Geometry::TriangleEdges &edges, const Types::Vec2i &reference,
+                const Triangle<V> &triangle, const Types::Mat3f *weights
+            );
+
+#ifdef __SSE2__
+            // Same as at(), but for the quad of pixels (x, y), (x+1, y), (x, y+1) and (x+1, y+1),
+            // with p = (x, y), into V4 (i.e. the same members as V, but with Simd::Float4 components)
+            // obs.: the lanes are computed with the same operations as at(), so the values are identical
+            template <typename V4>
+            inline V4 at_quad(const Types::Vec2i &p) const {
+                static_assert(sizeof(V4) == (N - 1) * sizeof(Simd::Float4), "V4 must be V with 4 lanes");
+                const Simd::Float4 dx = _mm_add_ps(_mm_set1_ps(static_cast<float>(p.x - _reference.x)), _mm_setr_ps(0, 1, 0, 1));
+                const Simd::Float4 dy = _mm_add_ps(_mm_set1_ps(static_cast<float>(p.y - _reference.y)), _mm_setr_ps(0, 0, 1, 1));
+                const Simd::Float4 w = _mm_div_ps(_mm_set1_ps(1.0f), evaluate(N - 1, dx, dy));
+
+                V4 varyings;
+                Simd::Float4 *out = reinterpret_cast<Simd::Float4 *>(&varyings);
+                for (int k = 0; k < N - 1; ++k)
+                    out[k] = _mm_mul_ps(evaluate(k, dx, dy), w);
+                return varyings;
+            }
+#endif
+
+            // Perspective correct values of the varyings at the center of pixel p
+            inline V at(const Types::Vec2i &p) const {
+                const float dx = static_cast<float>(p.x - _reference.x);
+                const float dy = static_cast<float>(p.y - _reference.y);
+                const float w = 1.0f / (_value[N - 1] + _d_dx[N - 1] * dx + _d_dy[N - 1] * dy);
+
+                V varyings;
+                float *out = Layout<V>::floats(varyings);
+                for (int k = 0; k < N - 1; ++k)
+                    out[k] = (_value[k] + _d_dx[k] * dx + _d_dy[k] * dy) * w;
+                return varyings;
+            }
+
+            // Differences of the varyings between the pixels of the quad that p is in, along x and y
+            // (i.e. their screen space derivatives), the same as a quad's fragment() takes between its
+            // lanes (from lane 0 to lane 1, and to lane 2), so the values are identical
+            // obs.: quads start at even pixels, as framebuffers' origins are even (see Draw::Kernels::triangle_quads)
+            inline void derivatives(const Types::Vec2i &p, V &d_dx, V &d_dy) const {
+                const Types::Vec2i quad(p.x & ~1, p.y & ~1);
+                const V at_quad = at(quad);
+                const V at_x = at(Types::Vec2i(quad.x + 1, quad.y));
+                const V at_y = at(Types::Vec2i(quad.x, quad.y + 1));
+
+                const float *in = Layout<V>::floats(at_quad);
+                const float *in_x = Layout<V>::floats(at_x);
+                const float *in_y = Layout<V>::floats(at_y);
+                float *out_x = Layout<V>::floats(d_dx);
+                float *out_y = Layout<V>::floats(d_dy);
+                for (int k = 0; k < N - 1; ++k) {
+                    out_x[k] = in_x[k] - in[k];
+                    out_y[k] = in_y[k] - in[k];
+                }
+            }
+    };
+
+    template <typename V>
+    Planes<V>::Planes(
+        const Geometry::TriangleEdges &edges, const Types::Vec2i &reference,
+        const Triangle<V> &triangle, const Types::Mat3f *weights
+    ) : _reference(reference) {
+        // values of each vertex divided by its w
+        // obs.: clipped vertices are linear combinations of the original ones in clip space,
+        //       so their varyings (and w) are the same combinations of the original values
+        float values[3][N];
+        for (int j = 0; j < 3; ++j) {
+            float w = 0.0f;
+            for (int k = 0; k < N - 1; ++k)
+                values[j][k] = 0.0f;
+            for (int i = 0; i < 3; ++i) {
+                const float weight = weights ? weights->cell(i, j) : static_cast<float>(i == j);
+                if (weight == 0.0f)
+                    continue;
+                const float *in = Layout<V>::floats(triangle.varyings[i]);
+                for (int k = 0; k < N - 1; ++k)
+                    values[j][k] += weight * in[k];
+                w += weight * triangle.clip_coords[i].w;
+            }
+
+            const float inv_w = 1.0f / w;
+            for (int k = 0; k < N - 1; ++k)
+                values[j][k] *= inv_w;
+            values[j][N - 1] = inv_w;
+        }
+
+        // barycentric coordinates at the reference pixel, and their increments along x and y
+        // obs.: they're derived from the same (fixed point) edge functions as the rasterizer's
+        const Types::Vec3f bc = edges.barycentric_coords(
+            edges.bc.at(reference), edges.ca.at(reference), edges.ab.at(reference)
+        );
+        const Types::Vec3f bc_dx(edges.bc.step_x() * edges.inv_area2,
+                                 edges.ca.step_x() * edges.inv_area2,
+                                 edges.ab.step_x() * edges.inv_area2);
+        const Types::Vec3f bc_dy(edges.bc.step_y() * edges.inv_area2,
+                                 edges.ca.step_y() * edges.inv_area2,
+                                 edges.ab.step_y() * edges.inv_area2);
+
+        for (int k = 0; k < N; ++k) {
+            _value[k] = Geometry::barycentric_interp(bc, values[0][k], values[1][k], values[2][k]);
+            _d_dx[k] = Geometry::barycentric_interp(bc_dx, values[0][k], values[1][k], values[2][k]);
+            _d_dy[k] = Geometry::barycentric_interp(bc_dy, values[0][k], values[1][k], values[2][k]);
+        }
+    }
+}
+
+#endif // __INTERPOLATION_HH__
\ No newline at end of file
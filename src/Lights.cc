@@ -0,0 +1,118 @@
+#include "Lights.hh"
+
+#include <cassert>
+
+using Types::Vec2i;
+using Types::Vec3f;
+using Types::Vec4f;
+using Types::Mat4f;
+
+namespace Lights {
+
+    ///////////////////////////////////////////////////////
+    /// Light /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Light Light::point(const Vec3f &position, const Vec3f &color, float radius) {
+        return { Type::Point, position, Vec3f(0, 0, -1), color, radius, -1.0f, -1.0f };
+    }
+
+    Light Light::spot(const Vec3f &position, const Vec3f &direction, const Vec3f &color,
+                      float radius, float inner_angle_deg, float outer_angle_deg) {
+        assert(inner_angle_deg < outer_angle_deg);
+        return {
+            Type::Spot, position, direction.normalized(), color, radius,
+            std::cos(Math::deg2rad(inner_angle_deg)), std::cos(Math::deg2rad(outer_angle_deg))
+        };
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Grid //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Grid::Grid(const Vec2i &resolution)
+        : _n_tiles((resolution.x + TILE_SIZE - 1) / TILE_SIZE,
+                   (resolution.y + TILE_SIZE - 1) / TILE_SIZE)
+        , _lights()
+        , _bounds()
+        , _tiles(_n_tiles.x * _n_tiles.y) { }
+
+    void Grid::set_lights(const std::vector<Light> &lights, const Mat4f &mvp, const Mat4f &viewport) {
+        _lights = lights;
+        _bounds.resize(lights.size());
+
+        // project the corners of the box around each light's sphere, which bound it on the screen,
+        // unless any of them is behind the camera (as then the sphere may cover the whole screen)
+        for (size_t i = 0; i < lights.size(); ++i) {
+            const Light &light = lights[i];
+            Bounds &bounds = _bounds[i];
+            bounds.min = Vec3f(Math::MAX_FLOAT);
+            bounds.max = Vec3f(Math::MIN_FLOAT);
+
+            for (int corner = 0; corner < 8; ++corner) {
+                const Vec3f offset(
+                    (corner & 1) ? light.radius : -light.radius,
+                    (corner & 2) ? light.radius : -light.radius,
+                    (corner & 4) ? light.radius : -light.radius
+                );
+                const Vec4f clip_coord = mvp * Vec4f(light.position + offset, 1);
+                if (clip_coord.w <= Math::EPS_FLOAT) {
+                    bounds.min = Vec3f(Math::MIN_FLOAT);
+                    bounds.max = Vec3f(Math::MAX_FLOAT);
+                    break;
+                }
+                const Vec3f screen_coord = (viewport * clip_coord.homogenized()).xyz();
+                for (int k = 0; k < 3; ++k) {
+                    bounds.min[k] = std::min(bounds.min[k], screen_coord[k]);
+                    bounds.max[k] = std::max(bounds.max[k], screen_coord[k]);
+                }
+            }
+        }
+    }
+
+    void Grid::cull(const Frame::Buffer &framebuffer, const Vec2i &origin) {
+        assert(origin.x % TILE_SIZE == 0 && origin.y % TILE_SIZE == 0);
+
+        const Vec2i &size = framebuffer.size();
+        const float *depth = framebuffer.depth();
+
+        Vec2i tile;
+        for (tile.y = origin.y / TILE_SIZE; tile.y * TILE_SIZE < origin.y + size.y; ++tile.y) {
+            for (tile.x = origin.x / TILE_SIZE; tile.x * TILE_SIZE < origin.x + size.x; ++tile.x) {
+                const Vec2i tile_min(tile.x * TILE_SIZE, tile.y * TILE_SIZE);
+                const Vec2i tile_max(std::min(tile_min.x + TILE_SIZE, origin.x + size.x),
+                                     std::min(tile_min.y + TILE_SIZE, origin.y + size.y)); // exclusive
+
+                // depth range of the pixels drawn in the tile (where larger values are closer)
+                float z_min = Math::MAX_FLOAT;
+                float z_max = Math::MIN_FLOAT;
+                Vec2i p;
+                for (p.y = tile_min.y; p.y < tile_max.y; ++p.y) {
+                    for (p.x = tile_min.x; p.x < tile_max.x; ++p.x) {
+                        const float z = depth[framebuffer.index(p - origin)];
+                        if (z != Math::MIN_FLOAT) {
+                            z_min = std::min(z_min, z);
+                            z_max = std::max(z_max, z);
+                        }
+                    }
+                }
+                if (z_min > z_max) {
+                    // nothing was drawn to the tile
+                    z_min = Math::MIN_FLOAT;
+                    z_max = Math::MAX_FLOAT;
+                }
+
+                std::vector<int> &tile_lights = _tiles[tile.x + tile.y * _n_tiles.x];
+                tile_lights.clear(); // obs.: keeps its capacity, so culling doesn't allocate every frame
+                for (int i = 0; i < n_lights(); ++i) {
+                    const Bounds &bounds = _bounds[i];
+                    if (bounds.max.x < tile_min.x || bounds.min.x > tile_max.x ||
+                        bounds.max.y < tile_min.y || bounds.min.y > tile_max.y ||
+                        bounds.max.z < z_min || bounds.min.z > z_max)
+                        continue;
+                    tile_lights.push_back(i);
+                }
+            }
+        }
+    }
+}
\ No newline at end of file
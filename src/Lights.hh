@@ -0,0 +1,137 @@
+#ifndef __LIGHTS_HH__
+#define __LIGHTS_HH__
+
+#include <cmath>
+#include <vector>
+
+#include "Math.hh"
+#include "Simd.hh"
+#include "Frame.hh"
+#include "Types.hh"
+
+namespace Lights {
+
+    static const int TILE_SIZE = 16; // in pixels (i.e. a Tiles::Tile has 4x4 light tiles)
+
+    ///////////////////////////////////////////////////////
+    /// Light /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    enum class Type {
+        Point, // lights all directions around its position
+        Spot,  // only lights a cone around its direction
+    };
+
+    // Local light, in object space (i.e. the same as the models' vertices), which only
+    // reaches points closer than its radius, so that it can be culled per screen tile
+    struct Light {
+        Type type;
+        Types::Vec3f position;
+        Types::Vec3f direction; // the axis of a spot light's cone (normalized)
+        Types::Vec3f color;     // RGB intensity
+        float radius;           // distance at which its attenuation reaches zero
+        float cos_inner;        // cosine of the half angle at which a spot light's cone starts fading out,
+        float cos_outer;        // and of the one at which it's fully faded out
+
+        static Light point(const Types::Vec3f &position, const Types::Vec3f &color, float radius);
+
+        static Light spot(
+            const Types::Vec3f &position, const Types::Vec3f &direction, const Types::Vec3f &color,
+            float radius, float inner_angle_deg, float outer_angle_deg
+        );
+
+        // Attenuation of the light at p, which is zero outside of its radius (or cone),
+        // with to_light set to the normalized direction from p to the light
+        inline float attenuation(const Types::Vec3f &p, Types::Vec3f &to_light) const {
+            to_light = position - p;
+            const float distance_squared = Math::max(dot(to_light, to_light), Math::EPS_FLOAT);
+            to_light *= 1.0f / std::sqrt(distance_squared);
+
+            // windowed falloff, so that it smoothly reaches zero at the radius
+            const float falloff = Math::saturate(1.0f - distance_squared / (radius * radius));
+            float result = falloff * falloff;
+            if (type == Type::Spot)
+                result *= Math::smoothstep(cos_outer, cos_inner, -dot(to_light, direction));
+            return result;
+        }
+
+#ifdef __SSE2__
+        // Same as above, for four points at once (in SoA form)
+        inline Simd::Float4 attenuation(
+            const Types::Vec3<Simd::Float4> &p, Types::Vec3<Simd::Float4> &to_light
+        ) const {
+            using Simd::Float4;
+            to_light = Simd::set1(position) - p;
+            const Float4 distance_squared = _mm_max_ps(dot(to_light, to_light), _mm_set1_ps(Math::EPS_FLOAT));
+            to_light = to_light * _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(distance_squared));
+
+            const Float4 one = _mm_set1_ps(1.0f);
+            const Float4 falloff = Simd::clamp(
+                _mm_sub_ps(one, _mm_mul_ps(distance_squared, _mm_set1_ps(1.0f / (radius * radius)))),
+                _mm_setzero_ps(), one
+            );
+            Float4 result = _mm_mul_ps(falloff, falloff);
+            if (type == Type::Spot) {
+                const Float4 t = Simd::clamp(
+                    _mm_mul_ps(
+                        _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), dot(to_light, Simd::set1(direction))), _mm_set1_ps(cos_outer)),
+                        _mm_set1_ps(1.0f / (cos_inner - cos_outer))
+                    ),
+                    _mm_setzero_ps(), one
+                );
+                result = _mm_mul_ps(result, _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t))));
+            }
+            return result;
+        }
+#endif
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Grid //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Lists of the lights that may reach each TILE_SIZE x TILE_SIZE tile of the screen, so that
+    // shading a pixel only loops over the lights of its tile, instead of all of them (Forward+)
+    // obs.: quads start at even pixels, so the four pixels of a quad are always in the same tile
+    class Grid {
+        private:
+            // Screen space box that a light's sphere of influence projects to
+            struct Bounds {
+                Types::Vec3f min;
+                Types::Vec3f max;
+            };
+
+            Types::Vec2i _n_tiles; // number of tile columns and rows
+
+            std::vector<Light> _lights;
+            std::vector<Bounds> _bounds; // of each light
+            std::vector<std::vector<int>> _tiles; // indices of the lights of each tile, in increasing order
+
+        public:
+            Grid(const Types::Vec2i &resolution);
+
+            // Sets the lights, and computes their bounds on the screen, given the transforms from
+            // object space to clip space (mvp) and from NDC to the screen (viewport)
+            // obs.: the tiles' lists are only updated by cull()
+            void set_lights(const std::vector<Light> &lights, const Types::Mat4f &mvp, const Types::Mat4f &viewport);
+
+            // Lists the lights that overlap each tile in [origin, origin + framebuffer.size()), both on
+            // the screen and in the depth range of the pixels drawn to framebuffer in the tile
+            // obs.: framebuffer should either hold the final depth of the scene (i.e. after a depth
+            //       pre-pass), or nothing, in which case lights are only culled on the screen
+            // obs.: origin must be a multiple of TILE_SIZE, so that framebuffers that don't overlap
+            //       (e.g. tiles) can be culled in parallel
+            void cull(const Frame::Buffer &framebuffer, const Types::Vec2i &origin = Types::Vec2i(0, 0));
+
+            int n_lights() const { return static_cast<int>(_lights.size()); }
+
+            const Light &light(int i) const { return _lights[i]; }
+
+            // Indices of the lights that may reach pixel p
+            inline const std::vector<int> &lights_at(const Types::Vec2i &p) const {
+                return _tiles[p.x / TILE_SIZE + (p.y / TILE_SIZE) * _n_tiles.x];
+            }
+    };
+}
+
+#endif // __LIGHTS_HH__
\ No newline at end of file
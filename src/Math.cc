@@ -13,10 +13,33 @@ namespace Math {
     }
 
     float srgb2linear(float color_srgb) {
-        return pow(color_srgb, 2.2f);
+        return color_srgb <= 0.04045f
+            ? color_srgb / 12.92f
+            : powf((color_srgb + 0.055f) / 1.055f, 2.4f);
     }
 
     float linear2srgb(float color_linear) {
-        return pow(color_linear, 1.0f / 2.2f);
+        return color_linear <= 0.0031308f
+            ? color_linear * 12.92f
+            : 1.055f * powf(color_linear, 1.0f / 2.4f) - 0.055f;
     }
+
+    ///////////////////////////////////////////////////////
+    /// sRGB tables ///////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // obs.: they're filled in before main starts (by dynamic initialization), from the functions above
+    const std::array<float, 256> SRGB8_TO_LINEAR = [] {
+        std::array<float, 256> table;
+        for (int code = 0; code < 256; ++code)
+            table[code] = srgb2linear(code / 255.0f);
+        return table;
+    }();
+
+    const std::array<unsigned char, SRGB_LUT_SIZE> LINEAR_TO_SRGB8 = [] {
+        std::array<unsigned char, SRGB_LUT_SIZE> table;
+        for (int i = 0; i < SRGB_LUT_SIZE; ++i)
+            table[i] = static_cast<unsigned char>(255.0f * linear2srgb(i / (SRGB_LUT_SIZE - 1.0f)) + 0.5f);
+        return table;
+    }();
 }
\ No newline at end of file
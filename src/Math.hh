@@ -1,6 +1,7 @@
 #ifndef __MATH_HH__
 #define __MATH_HH__
 
+#include <array>
 #include <algorithm>
 #include <limits>
 
@@ -31,10 +32,35 @@ namespace Math {
 
     float rad2deg(float angle_rad);
 
+    // sRGB transfer functions, between encoded and linear values in [0, 1]
+    // ref.: IEC 61966-2-1:1999
+    // obs.: these call pow, so per pixel conversions should use the tables below instead
     float srgb2linear(float color_srgb);
 
     float linear2srgb(float color_linear);
 
+    ///////////////////////////////////////////////////////
+    /// sRGB tables ///////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Number of (evenly spaced) linear values in [0, 1] whose 8-bit sRGB code is tabulated,
+    // which is enough for the closest one to be at most a code away from the exact conversion
+    static const int SRGB_LUT_SIZE = 4096;
+
+    extern const std::array<float, 256> SRGB8_TO_LINEAR;
+    extern const std::array<unsigned char, SRGB_LUT_SIZE> LINEAR_TO_SRGB8;
+
+    // Linear value, in [0, 1], of an 8-bit sRGB code
+    inline float srgb8_to_linear(unsigned char code) {
+        return SRGB8_TO_LINEAR[code];
+    }
+
+    // 8-bit sRGB code of a linear value, which is clamped to [0, 1]
+    inline unsigned char linear_to_srgb8(float color_linear) {
+        const float index = std::min(std::max(color_linear, 0.0f), 1.0f) * (SRGB_LUT_SIZE - 1) + 0.5f;
+        return LINEAR_TO_SRGB8[static_cast<int>(index)];
+    }
+
     template <typename T>
     T min(const T &a, const T &b) {
         return a < b ? a : b;
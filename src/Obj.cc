@@ -1,12 +1,19 @@
 #include "Obj.hh"
 
+#include <map>
+#include <atomic>
+#include <cmath>
+#include <tuple>
 #include <sstream>
 
+#include "Math.hh"
+
 using Types::Vec2i;
 using Types::Vec3i;
 
 using Types::Vec2f;
 using Types::Vec3f;
+using Types::Vec4f;
 
 namespace Obj {
 
@@ -40,14 +47,28 @@ namespace Obj {
     /// Model /////////////////////////////////////////////
     ///////////////////////////////////////////////////////
 
+    // Texture of the maps that a model doesn't have (i.e. an empty one, which samples as black),
+    // shared by every model, so that their handles are never null, even if the .obj can't be read
+    static const Textures::Handle &no_texture() {
+        static const Textures::Handle empty = std::make_shared<const Textures::Texture>();
+        return empty;
+    }
+
+    // Generation of the next model created (see Model::generation)
+    static std::atomic<unsigned long> next_generation(0);
+
     Model::Model(const char *filename)
         : _positions()
         , _uv_textures()
         , _normals()
         , _faces_indices()
-        , _diffuse_map()
-        , _normal_map()
-        , _specular_map() {
+        , _unique_vertices()
+        , _unique_vertex_ids()
+        , _tangents()
+        , _diffuse_map(no_texture())
+        , _normal_map(no_texture())
+        , _specular_map(no_texture())
+        , _generation(next_generation++) {
         std::ifstream in;
         in.open(filename, std::ifstream::in);
         if (in.fail())
@@ -98,6 +119,9 @@ namespace Obj {
                   << " f# "  << _faces_indices.size()
                   << std::endl;
 
+        index_unique_vertices();
+        compute_tangents();
+
         load_texture(filename, "_diffuse.tga", _diffuse_map);
         load_texture(filename, "_nm_tangent.tga", _normal_map);
         load_texture(filename, "_spec.tga", _specular_map);
@@ -105,15 +129,91 @@ namespace Obj {
 
     Model::~Model() { }
 
-    void Model::load_texture(std::string filename, const char *suffix, TGAImage &image) {
+    void Model::load_texture(std::string filename, const char *suffix, Textures::Handle &texture) {
         std::string texfile(filename);
         size_t dot = texfile.find_last_of(".");
         if (dot != std::string::npos) {
             texfile = texfile.substr(0, dot) + std::string(suffix);
+            texture = Textures::cache().load(texfile); // only decoded (and mipmapped) if it isn't cached
             std::cerr << "texture file " << texfile << " loading "
-                      << (image.read_tga_file(texfile.c_str()) ? "ok" : "failed")
+                      << (texture ? "ok" : "failed")
                       << std::endl;
-            image.flip_vertically();
+        }
+        if (!texture)
+            texture = no_texture();
+    }
+
+    void Model::index_unique_vertices() {
+        std::map<std::tuple<int, int, int>, int> ids;
+        _unique_vertex_ids.reserve(3 * _faces_indices.size());
+        for (const FaceIndices &face_indices : _faces_indices) {
+            for (int j = 0; j < 3; ++j) {
+                const VertexIndices &i = face_indices[j];
+                auto inserted = ids.emplace(std::make_tuple(i.p, i.t, i.n), static_cast<int>(_unique_vertices.size()));
+                if (inserted.second)
+                    _unique_vertices.push_back(i);
+                _unique_vertex_ids.push_back(inserted.first->second);
+            }
+        }
+    }
+
+    void Model::compute_tangents() {
+        // accumulate the tangent (and bitangent) of each face on its vertices, weighted
+        // by the face's angle at them (so that how a surface is triangulated doesn't matter)
+        std::vector<Vec3f> tangents(_unique_vertices.size());
+        std::vector<Vec3f> bitangents(_unique_vertices.size());
+        for (int iface = 0; iface < n_of_faces(); ++iface) {
+            Vec3f p[3];
+            Vec2f t[3];
+            for (int j = 0; j < 3; ++j) {
+                p[j] = position(iface, j);
+                t[j] = uv(iface, j);
+            }
+
+            // solve e1 = du1 * T + dv1 * B and e2 = du2 * T + dv2 * B for the face's T and B
+            const Vec3f e1 = p[1] - p[0];
+            const Vec3f e2 = p[2] - p[0];
+            const Vec2f d1 = t[1] - t[0];
+            const Vec2f d2 = t[2] - t[0];
+            const float det = d1.x * d2.y - d2.x * d1.y;
+            if (std::abs(det) < Math::EPS_FLOAT)
+                continue; // degenerate in uv space (e.g. a face without a texture)
+
+            Vec3f face_tangent = (e1 * d2.y - e2 * d1.y) * (1.0f / det);
+            Vec3f face_bitangent = (e2 * d1.x - e1 * d2.x) * (1.0f / det);
+            if (face_tangent.length() < Math::EPS_FLOAT || face_bitangent.length() < Math::EPS_FLOAT)
+                continue; // degenerate in space (e.g. collapsed positions), although not in uv space
+            face_tangent.normalize();
+            face_bitangent.normalize();
+
+            for (int j = 0; j < 3; ++j) {
+                Vec3f to_next = p[(j + 1) % 3] - p[j];
+                Vec3f to_prev = p[(j + 2) % 3] - p[j];
+                const float length = to_next.length() * to_prev.length();
+                if (length < Math::EPS_FLOAT)
+                    continue;
+                const float angle = std::acos(Math::clamp(dot(to_next, to_prev) / length, -1.0f, 1.0f));
+
+                const int id = unique_vertex_id(iface, j);
+                tangents[id] += face_tangent * angle;
+                bitangents[id] += face_bitangent * angle;
+            }
+        }
+
+        // orthonormalize each tangent w.r.t. its vertex normal (Gram-Schmidt),
+        // and keep whether the accumulated bitangent agrees with cross(normal, tangent)
+        _tangents.resize(_unique_vertices.size());
+        for (size_t id = 0; id < _unique_vertices.size(); ++id) {
+            const Vec3f n = Vec3f(_normals[_unique_vertices[id].n]).normalize();
+            Vec3f tangent = tangents[id] - n * dot(n, tangents[id]);
+            if (tangent.length() < Math::EPS_FLOAT) {
+                // no tangent from the faces, so pick any direction perpendicular to the normal
+                tangent = std::abs(n.x) < 0.9f ? cross(n, Vec3f(1, 0, 0)) : cross(n, Vec3f(0, 1, 0));
+            }
+            tangent.normalize();
+
+            const float handedness = dot(cross(n, tangent), bitangents[id]) < 0.0f ? -1.0f : 1.0f;
+            _tangents[id] = Vec4f(tangent, handedness);
         }
     }
 
@@ -125,6 +225,10 @@ namespace Obj {
         return static_cast<int>(_faces_indices.size());
     }
 
+    int Model::n_of_unique_vertices() {
+        return static_cast<int>(_unique_vertices.size());
+    }
+
     Primitives::Face Model::face(int i) {
         FaceIndices face_indices = _faces_indices[i];
         return Primitives::Face(
@@ -143,8 +247,21 @@ namespace Obj {
     }
 
     Primitives::Vertex Model::vertex(int iface, int nthvert) {
-        VertexIndices i = _faces_indices[iface][nthvert];
-        return vertex(i);
+        return unique_vertex(unique_vertex_id(iface, nthvert));
+    }
+
+    int Model::unique_vertex_id(int iface, int nthvert) {
+        return _unique_vertex_ids[3 * iface + nthvert];
+    }
+
+    Primitives::Vertex Model::unique_vertex(int id) {
+        const VertexIndices &i = _unique_vertices[id];
+        return Primitives::Vertex(
+            _positions[i.p],
+            _uv_textures[i.t],
+            _normals[i.n],
+            _tangents[id]
+        );
     }
 
     FaceIndices Model::face_indices(int i) {
@@ -175,32 +292,57 @@ namespace Obj {
         return normal(_faces_indices[iface][nthvert].n);
     }
 
-    TGAColor Model::diffuse_map_at(Vec2f uv) const {
-        Vec2i UV(
-            uv.x * _diffuse_map.get_width(), // [-1, 1] -> [-width, width]
-            uv.y * _diffuse_map.get_height() // [-1, 1] -> [-height, height]
-        );
-        return _diffuse_map.get(UV.x, UV.y);
+    Vec4f Model::tangent(int id) {
+        return _tangents[id];
+    }
+
+    Vec4f Model::tangent(int iface, int nthvert) {
+        return tangent(unique_vertex_id(iface, nthvert));
+    }
+
+    Vec3f Model::bitangent(int id) {
+        const Vec3f n = Vec3f(_normals[_unique_vertices[id].n]).normalize();
+        return cross(n, _tangents[id].xyz()) * _tangents[id].w;
     }
 
-    Vec3f Model::normal_map_at(Vec2f uv) const {
-        Vec2i UV(
-            uv.x * _normal_map.get_width(), // [-1, 1] -> [-width, width]
-            uv.y * _normal_map.get_height() // [-1, 1] -> [-height, height]
+    Vec3f Model::bitangent(int iface, int nthvert) {
+        return bitangent(unique_vertex_id(iface, nthvert));
+    }
+
+    const Textures::Sampler Model::NEAREST(Textures::Filter::Nearest, Textures::Wrap::Repeat);
+
+    bool Model::has_diffuse_map() const {
+        return !_diffuse_map->empty();
+    }
+
+    bool Model::has_normal_map() const {
+        return !_normal_map->empty();
+    }
+
+    bool Model::has_specular_map() const {
+        return !_specular_map->empty();
+    }
+
+    TGAColor Model::diffuse_map_at(Vec2f uv, const Textures::Sampler &sampler, float lod) const {
+        const Vec4f c = _diffuse_map->sample(sampler, uv, lod); // BGRA
+        return TGAColor(
+            static_cast<unsigned char>(c[2] + 0.5f),
+            static_cast<unsigned char>(c[1] + 0.5f),
+            static_cast<unsigned char>(c[0] + 0.5f),
+            static_cast<unsigned char>(c[3] + 0.5f)
         );
-        TGAColor c = _normal_map.get(UV.x, UV.y); // BGRA
+    }
+
+    Vec3f Model::normal_map_at(Vec2f uv, const Textures::Sampler &sampler, float lod) const {
+        const Vec4f c = _normal_map->sample(sampler, uv, lod); // BGRA
         return Vec3f(
-            static_cast<float>(c[2]) / 255.f * 2.f - 1.f, // R
-            static_cast<float>(c[1]) / 255.f * 2.f - 1.f, // G
-            static_cast<float>(c[0]) / 255.f * 2.f - 1.f  // B
+            c[2] / 255.f * 2.f - 1.f, // R
+            c[1] / 255.f * 2.f - 1.f, // G
+            c[0] / 255.f * 2.f - 1.f  // B
         ); // [0, 255] -> [-1, 1]
     }
 
-    float Model::specular_map_at(Vec2f uv) const {
-        Vec2i UV(
-            uv.x * _specular_map.get_width(), // [-1, 1] -> [-width, width]
-            uv.y * _specular_map.get_height() // [-1, 1] -> [-height, height]
-        );
-        return static_cast<float>(_specular_map.get(UV.x, UV.y)[0]); // B channel
+    float Model::specular_map_at(Vec2f uv, const Textures::Sampler &sampler, float lod) const {
+        return _specular_map->sample(sampler, uv, lod)[0]; // B channel
     }
 }
\ No newline at end of file
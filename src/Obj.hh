@@ -7,6 +7,7 @@
 #include "tgaimage.hh"
 
 #include "Types.hh"
+#include "Textures.hh"
 #include "Primitives.hh"
 
 namespace Obj {
@@ -68,29 +69,54 @@ namespace Obj {
 
             std::vector<FaceIndices> _faces_indices;
 
+            // distinct VertexIndices of the faces (i.e. the vertices a vertex shader needs to run on),
+            // and the index in it of each vertex of each face (3 per face)
+            std::vector<VertexIndices> _unique_vertices;
+            std::vector<int> _unique_vertex_ids;
+
+            void index_unique_vertices();
+
+            // tangent frame of each unique vertex (see Primitives::Vertex::tangent)
+            std::vector<Types::Vec4f> _tangents;
+
+            void compute_tangents();
+
             // ref.: https://help.poliigon.com/en/articles/1712652-what-are-the-different-texture-maps-for
-            TGAImage _diffuse_map;  // color
-            TGAImage _normal_map;   // bump
-            TGAImage _specular_map; // reflection
+            Textures::Handle _diffuse_map;  // color
+            Textures::Handle _normal_map;   // bump
+            Textures::Handle _specular_map; // reflection
+            // obs.: they're shared with other models (through Textures::cache()), and never null
 
             void load_texture(
                 std::string filename, const char *suffix,
-                TGAImage &image
+                Textures::Handle &texture
             );
 
+            unsigned long _generation;
+
         public:
             Model(const char *filename);
             ~Model();
 
+            // Identifies the model's contents: it's distinct for every model created in the process
+            // (even one that reuses the address of a deleted model), so it can key caches of them
+            unsigned long generation() const { return _generation; }
+
             int n_of_vertices();
             int n_of_faces();
+            int n_of_unique_vertices(); // distinct VertexIndices, shared by adjacent faces
 
             /// property accessors ////////////////////////////////
 
             Primitives::Face face(int i); // builds a face from _faces_indices[i]
 
-            Primitives::Vertex vertex(VertexIndices i);
-            Primitives::Vertex vertex(int iface, int nthvert); // vertex(face_indices(iface)[nthvert])
+            Primitives::Vertex vertex(VertexIndices i); // obs.: without its tangent, as it's per unique vertex
+            Primitives::Vertex vertex(int iface, int nthvert); // unique_vertex(unique_vertex_id(iface, nthvert))
+
+            // Unique vertices are numbered from 0 to n_of_unique_vertices() - 1, so that
+            // per-vertex results (e.g. of a vertex shader) can be computed once, and shared
+            int unique_vertex_id(int iface, int nthvert);
+            Primitives::Vertex unique_vertex(int id);
 
             // below are some leaky abstractions,
             // you should favor using the ones above
@@ -106,11 +132,32 @@ namespace Obj {
             Types::Vec3f normal(int i);
             Types::Vec3f normal(int iface, int nthvert);
 
+            // obs.: tangents are computed when loading the model, for each unique vertex (as they
+            //       depend on its uv, and on its normal), so they're indexed by unique vertex id
+            Types::Vec4f tangent(int id);
+            Types::Vec4f tangent(int iface, int nthvert);
+
+            Types::Vec3f bitangent(int id);
+            Types::Vec3f bitangent(int iface, int nthvert);
+
             /// texture maps //////////////////////////////////////
 
-            TGAColor diffuse_map_at(Types::Vec2f uv) const;
-            Types::Vec3f normal_map_at(Types::Vec2f uv) const;
-            float specular_map_at(Types::Vec2f uv) const;
+            // obs.: maps that failed to load (e.g. missing files) are empty, and sample as black
+            bool has_diffuse_map() const;
+            bool has_normal_map() const;
+            bool has_specular_map() const;
+
+            const Textures::Texture &diffuse_map() const { return *_diffuse_map; }
+            const Textures::Texture &normal_map() const { return *_normal_map; }
+            const Textures::Texture &specular_map() const { return *_specular_map; }
+
+            // Samples each map at uv with sampler (by default, the closest texel of the full size level,
+            // with uv wrapping around), at the level of detail lod (see Textures::Texture::lod)
+            TGAColor diffuse_map_at(Types::Vec2f uv, const Textures::Sampler &sampler = NEAREST, float lod = 0.0f) const;
+            Types::Vec3f normal_map_at(Types::Vec2f uv, const Textures::Sampler &sampler = NEAREST, float lod = 0.0f) const;
+            float specular_map_at(Types::Vec2f uv, const Textures::Sampler &sampler = NEAREST, float lod = 0.0f) const;
+
+            static const Textures::Sampler NEAREST;
     };
 }
 
@@ -0,0 +1,230 @@
+#include "Occlusion.hh"
+
+#include <cmath>
+#include <algorithm>
+
+#include "Math.hh"
+
+using Types::Vec2i;
+using Types::Vec3f;
+using Types::Vec4f;
+using Types::Mat4f;
+
+namespace Occlusion {
+
+    // Rotation of the sampling pattern of each pixel, in a 4x4 ordered dither (which the
+    // 4x4 blur averages out), so that neighboring pixels sample different directions
+    static const int DITHER[4][4] = {
+        {  0,  8,  2, 10 },
+        { 12,  4, 14,  6 },
+        {  3, 11,  1,  9 },
+        { 15,  7, 13,  5 },
+    };
+
+    // Largest radius of the samples, in half resolution pixels, bounding the cost of close ups
+    static const float MAX_RADIUS = 32.0f;
+
+    // Angle between consecutive samples, which spreads any number of them evenly around a spiral
+    static const float GOLDEN_ANGLE = 2.39996322972865332f;
+
+    // Weight of a neighbor that's dz (in view space) away from the pixel being filtered
+    static inline float similarity(float dz, float tolerance) {
+        const float t = dz / tolerance;
+        return 1.0f / (1.0f + t * t);
+    }
+
+    Pass::Pass(const Vec2i &resolution, const Mat4f &projection, const Mat4f &viewport,
+               Parallel::Pool &pool, const Options &options)
+        : _resolution(resolution)
+        , _half_resolution((resolution.x + 1) / 2, (resolution.y + 1) / 2)
+        , _to_screen(viewport * projection)
+        , _to_view(_to_screen.inversed())
+        , _options(options)
+        , _pool(pool)
+        , _half_depth(_half_resolution.x * _half_resolution.y)
+        , _half_positions(_half_resolution.x * _half_resolution.y)
+        , _half_occlusion(_half_resolution.x * _half_resolution.y)
+        , _half_blurred(_half_resolution.x * _half_resolution.y) { }
+
+    void Pass::apply(const float *depth, TGAImage &image) {
+        // obs.: each stage only reads what the previous one wrote, so its rows run in parallel
+        _pool.run(_half_resolution.y, [&](int y, int thread_id) { downsample(depth, y); });
+        _pool.run(_half_resolution.y, [&](int y, int thread_id) { occlude(y); });
+        _pool.run(_half_resolution.y, [&](int y, int thread_id) { blur(y); });
+        _pool.run(_resolution.y, [&](int y, int thread_id) { upsample(depth, image, y); });
+    }
+
+    Vec3f Pass::to_view(float x, float y, float depth) const {
+        return (_to_view * Vec4f(x, y, depth, 1)).homogenized().xyz();
+    }
+
+    void Pass::downsample(const float *depth, int y) {
+        for (int x = 0; x < _half_resolution.x; ++x) {
+            // keep the closest depth, so that thin foreground details aren't lost
+            float closest = Math::MIN_FLOAT;
+            for (int j = 2 * y; j < std::min(2 * y + 2, _resolution.y); ++j)
+                for (int i = 2 * x; i < std::min(2 * x + 2, _resolution.x); ++i)
+                    closest = std::max(closest, depth[i + j * _resolution.x]);
+
+            const int index = x + y * _half_resolution.x;
+            _half_depth[index] = closest;
+            if (closest != Math::MIN_FLOAT)
+                _half_positions[index] = to_view(2 * x + 1, 2 * y + 1, closest);
+        }
+    }
+
+    Vec3f Pass::normal_at(const Vec2i &p) const {
+        const int index = p.x + p.y * _half_resolution.x;
+        const Vec3f &position = _half_positions[index];
+
+        // difference to the neighbor (on either side) that's closest in depth, so that
+        // normals along silhouettes aren't bent towards the surfaces behind them
+        auto derivative = [&](int offset, bool has_prev, bool has_next) {
+            const bool use_prev = has_prev && _half_depth[index - offset] != Math::MIN_FLOAT;
+            const bool use_next = has_next && _half_depth[index + offset] != Math::MIN_FLOAT;
+            const Vec3f prev = use_prev ? position - _half_positions[index - offset] : Vec3f(0);
+            const Vec3f next = use_next ? _half_positions[index + offset] - position : Vec3f(0);
+            if (!use_next || (use_prev && std::abs(prev.z) < std::abs(next.z)))
+                return prev;
+            return next;
+        };
+
+        const Vec3f dx = derivative(1, p.x > 0, p.x + 1 < _half_resolution.x);
+        const Vec3f dy = derivative(_half_resolution.x, p.y > 0, p.y + 1 < _half_resolution.y);
+
+        // obs.: the screen's x and y axes are the view's, so their cross product faces the camera
+        const Vec3f normal = cross(dx, dy);
+        const float length = normal.length();
+        return length > Math::EPS_FLOAT ? normal * (1.0f / length) : Vec3f(0, 0, 1);
+    }
+
+    void Pass::occlude(int y) {
+        const float radius = _options.radius;
+        const float scale = 2.0f * _options.intensity / _options.n_samples;
+
+        for (int x = 0; x < _half_resolution.x; ++x) {
+            const int index = x + y * _half_resolution.x;
+            _half_occlusion[index] = 1.0f;
+            if (_half_depth[index] == Math::MIN_FLOAT)
+                continue;
+
+            const Vec3f &position = _half_positions[index];
+            const Vec3f normal = normal_at(Vec2i(x, y));
+
+            // project the radius to the screen, at the point's depth
+            const Vec4f center = _to_screen * Vec4f(position, 1);
+            const Vec4f offset = _to_screen * Vec4f(position + Vec3f(radius, 0, 0), 1);
+            const float screen_radius = std::min(
+                0.5f * std::abs(offset.x / offset.w - center.x / center.w), MAX_RADIUS
+            );
+            if (screen_radius < 1.0f)
+                continue; // too far away for its neighbors to be apart
+
+            // ref.: McGuire et al., "The Alchemy Screen-Space Ambient Obscurance Algorithm" (2011)
+            const float rotation = DITHER[y & 3][x & 3] * (2.0f * Math::PI / 16.0f);
+            float sum = 0.0f;
+            for (int i = 0; i < _options.n_samples; ++i) {
+                const float ratio = (i + 0.5f) / _options.n_samples;
+                const float angle = i * GOLDEN_ANGLE + rotation;
+                const int sx = x + static_cast<int>(std::round(std::cos(angle) * ratio * screen_radius));
+                const int sy = y + static_cast<int>(std::round(std::sin(angle) * ratio * screen_radius));
+                if (sx < 0 || sx >= _half_resolution.x || sy < 0 || sy >= _half_resolution.y)
+                    continue;
+                const int sample = sx + sy * _half_resolution.x;
+                if (_half_depth[sample] == Math::MIN_FLOAT)
+                    continue;
+
+                // vector to the sample, relative to the radius, which only occludes the point when
+                // it's above its tangent plane, and inside of the radius
+                const Vec3f v = (_half_positions[sample] - position) * (1.0f / radius);
+                const float v_dot_v = dot(v, v);
+                if (v_dot_v < 1.0f)
+                    sum += Math::max(dot(v, normal) - _options.bias, 0.0f) / (v_dot_v + 0.01f);
+            }
+
+            _half_occlusion[index] = std::pow(Math::max(1.0f - scale * sum, 0.0f), _options.contrast);
+        }
+    }
+
+    void Pass::blur(int y) {
+        const float tolerance = 0.1f * _options.radius;
+
+        for (int x = 0; x < _half_resolution.x; ++x) {
+            const int index = x + y * _half_resolution.x;
+            if (_half_depth[index] == Math::MIN_FLOAT) {
+                _half_blurred[index] = 1.0f;
+                continue;
+            }
+
+            // 4x4 window, matching the dither's period, weighted by the neighbors' depths
+            const float z = _half_positions[index].z;
+            float sum = 0.0f;
+            float weights = 0.0f;
+            for (int j = std::max(y - 1, 0); j <= std::min(y + 2, _half_resolution.y - 1); ++j) {
+                for (int i = std::max(x - 1, 0); i <= std::min(x + 2, _half_resolution.x - 1); ++i) {
+                    const int neighbor = i + j * _half_resolution.x;
+                    if (_half_depth[neighbor] == Math::MIN_FLOAT)
+                        continue;
+                    const float weight = similarity(_half_positions[neighbor].z - z, tolerance);
+                    sum += weight * _half_occlusion[neighbor];
+                    weights += weight;
+                }
+            }
+            _half_blurred[index] = sum / weights;
+        }
+    }
+
+    void Pass::upsample(const float *depth, TGAImage &image, int y) const {
+        const float tolerance = 0.1f * _options.radius;
+        const int bytespp = image.get_bytespp();
+        const int n_channels = std::min(bytespp, 3); // i.e. alpha isn't occluded
+        unsigned char *row = image.buffer() + y * _resolution.x * bytespp;
+
+        // the center of pixel y is at (y + 0.5) / 2 in the half resolution buffers, whose
+        // pixels' centers are at their index + 0.5, i.e. at index y / 2 - 0.25
+        const float half_y = 0.5f * y - 0.25f;
+        const int y0 = Math::clamp(static_cast<int>(std::floor(half_y)), 0, _half_resolution.y - 1);
+        const int y1 = std::min(y0 + 1, _half_resolution.y - 1);
+        const float ty = Math::saturate(half_y - y0);
+
+        for (int x = 0; x < _resolution.x; ++x) {
+            const float z = depth[x + y * _resolution.x];
+            if (z == Math::MIN_FLOAT)
+                continue;
+
+            const float half_x = 0.5f * x - 0.25f;
+            const int x0 = Math::clamp(static_cast<int>(std::floor(half_x)), 0, _half_resolution.x - 1);
+            const int x1 = std::min(x0 + 1, _half_resolution.x - 1);
+            const float tx = Math::saturate(half_x - x0);
+
+            // bilinear weights of the 4 closest half resolution pixels, scaled by how close their
+            // depths are to the pixel's, so that occlusion doesn't bleed across silhouettes
+            const float view_z = to_view(x + 0.5f, y + 0.5f, z).z;
+            const int neighbors[4] = {
+                x0 + y0 * _half_resolution.x, x1 + y0 * _half_resolution.x,
+                x0 + y1 * _half_resolution.x, x1 + y1 * _half_resolution.x,
+            };
+            const float bilinear[4] = {
+                (1 - tx) * (1 - ty), tx * (1 - ty),
+                (1 - tx) * ty,       tx * ty,
+            };
+            float sum = 0.0f;
+            float weights = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                if (_half_depth[neighbors[k]] == Math::MIN_FLOAT)
+                    continue;
+                const float weight = (bilinear[k] + Math::EPS_FLOAT)
+                                   * similarity(_half_positions[neighbors[k]].z - view_z, tolerance);
+                sum += weight * _half_blurred[neighbors[k]];
+                weights += weight;
+            }
+            if (weights == 0.0f)
+                continue; // obs.: a 2x2 block with a drawn pixel always has a depth
+
+            const float occlusion = sum / weights;
+            unsigned char *pixel = row + x * bytespp;
+            for (int c = 0; c < n_channels; ++c)
+                pixel[c] = static_cast<unsigned char>(pixel[c] * occlusion + 0.5f);
+        }
+    }
+}
\ No newline at end of file
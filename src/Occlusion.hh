@@ -0,0 +1,74 @@
+#ifndef __OCCLUSION_HH__
+#define __OCCLUSION_HH__
+
+#include <vector>
+
+#include "tgaimage.hh"
+
+#include "Types.hh"
+#include "Parallel.hh"
+
+namespace Occlusion {
+
+    ///////////////////////////////////////////////////////
+    /// Options ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    struct Options {
+        float radius = 0.25f;   // of the neighborhood around each point that may occlude it, in view space
+        float intensity = 1.0f; // scales the occlusion of each sample
+        float contrast = 1.0f;  // exponent applied to the ambient light that's left
+        float bias = 0.05f;     // cosine under which samples don't occlude (avoiding self-occlusion)
+        int n_samples = 12;     // per (half resolution) pixel
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Pass //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Screen space ambient occlusion, computed from the depth buffer after rasterization
+    // (so its cost only depends on the resolution), at half resolution, and then upsampled
+    // to the full resolution with a bilateral (i.e. depth aware) filter
+    // obs.: there's no normal buffer, so normals are reconstructed from the depth's derivatives
+    class Pass {
+        private:
+            Types::Vec2i _resolution;
+            Types::Vec2i _half_resolution; // rounded up
+
+            Types::Mat4f _to_screen; // viewport * projection
+            Types::Mat4f _to_view;   // its inverse
+
+            Options _options;
+            Parallel::Pool &_pool;
+
+            // obs.: in a linear layout, with a depth of MIN_FLOAT where nothing was drawn
+            std::vector<float> _half_depth;            // closest depth (in screen space) of each 2x2 pixels
+            std::vector<Types::Vec3f> _half_positions; // and its position in view space
+            std::vector<float> _half_occlusion;        // ambient light that reaches it, in [0, 1]
+            std::vector<float> _half_blurred;          // same as above, after the bilateral blur
+
+            Types::Vec3f to_view(float x, float y, float depth) const;
+
+            // Each stage writes a row of its (half or full resolution) output
+            void downsample(const float *depth, int y);
+            void occlude(int y);
+            void blur(int y);
+            void upsample(const float *depth, TGAImage &image, int y) const;
+
+            // Normal (in view space) of the surface at pixel p of the half resolution buffers
+            Types::Vec3f normal_at(const Types::Vec2i &p) const;
+
+        public:
+            // obs.: projection and viewport are the transforms used to draw the depth buffer
+            Pass(
+                const Types::Vec2i &resolution, const Types::Mat4f &projection, const Types::Mat4f &viewport,
+                Parallel::Pool &pool, const Options &options = Options()
+            );
+
+            // Darkens image's colors by the ambient occlusion of the scene drawn to depth, which
+            // is in a linear layout (see Frame::Buffer::resolve_depth), as is image (before flipping it)
+            void apply(const float *depth, TGAImage &image);
+    };
+}
+
+#endif // __OCCLUSION_HH__
\ No newline at end of file
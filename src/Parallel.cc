@@ -0,0 +1,86 @@
+#include "Parallel.hh"
+
+#include <algorithm>
+
+namespace Parallel {
+
+    ///////////////////////////////////////////////////////
+    /// Pool //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Pool::Pool(int n_threads)
+        : _workers()
+        , _task(nullptr)
+        , _n_tasks(0)
+        , _next_task(0)
+        , _n_busy_workers(0)
+        , _generation(0)
+        , _stop(false) {
+        if (n_threads <= 0)
+            n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // obs.: the thread calling run() also works, with thread_id = 0
+        for (int thread_id = 1; thread_id < n_threads; ++thread_id)
+            _workers.emplace_back(&Pool::work, this, thread_id);
+    }
+
+    Pool::~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (std::thread &worker : _workers)
+            worker.join();
+    }
+
+    int Pool::n_threads() const {
+        return static_cast<int>(_workers.size()) + 1;
+    }
+
+    void Pool::run(int n_tasks, const std::function<void(int, int)> &task) {
+        if (n_tasks <= 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _n_tasks = n_tasks;
+            _next_task = 0;
+            _n_busy_workers = static_cast<int>(_workers.size());
+            ++_generation;
+        }
+        _wake.notify_all();
+
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _n_busy_workers == 0; });
+        _task = nullptr;
+    }
+
+    void Pool::work(int thread_id) {
+        unsigned int seen_generation = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&] { return _stop || _generation != seen_generation; });
+                if (_stop)
+                    return;
+                seen_generation = _generation;
+            }
+
+            drain(thread_id);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_n_busy_workers == 0)
+                _done.notify_one();
+        }
+    }
+
+    void Pool::drain(int thread_id) {
+        // tasks are handed out one at a time, so uneven ones are balanced among threads
+        for (int i = _next_task++; i < _n_tasks; i = _next_task++)
+            (*_task)(i, thread_id);
+    }
+}
\ No newline at end of file
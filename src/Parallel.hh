@@ -0,0 +1,54 @@
+#ifndef __PARALLEL_HH__
+#define __PARALLEL_HH__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+    ///////////////////////////////////////////////////////
+    /// Pool //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Fixed set of worker threads that are kept alive between calls to run(),
+    // so that splitting each pass of a frame into tasks is cheap
+    class Pool {
+        private:
+            std::vector<std::thread> _workers;
+
+            std::mutex _mutex;
+            std::condition_variable _wake; // signals a new batch of tasks (or _stop)
+            std::condition_variable _done; // signals that all workers are idle
+
+            const std::function<void(int, int)> *_task;
+            int _n_tasks;
+            std::atomic<int> _next_task;
+            int _n_busy_workers;
+            unsigned int _generation; // incremented on each call to run()
+            bool _stop;
+
+            void work(int thread_id);
+            void drain(int thread_id);
+
+        public:
+            // obs.: n_threads <= 0 uses all hardware threads
+            explicit Pool(int n_threads = 0);
+            ~Pool();
+
+            Pool(const Pool &) = delete;
+            Pool &operator=(const Pool &) = delete;
+
+            // Number of threads running tasks, including the one calling run()
+            int n_threads() const;
+
+            // Calls task(i, thread_id) for every i in [0, n_tasks), blocking until all are done
+            // obs.: thread_id ∈ [0, n_threads()), so it can index per-thread data
+            void run(int n_tasks, const std::function<void(int, int)> &task);
+    };
+}
+
+#endif // __PARALLEL_HH__
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "PostTransform.hh"
+
+namespace PostTransform {
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    float Stats::hit_rate() const {
+        return n_vertices > 0 ? static_cast<float>(n_vertices - n_shaded) / n_vertices : 0.0f;
+    }
+
+    void Stats::clear() {
+        *this = Stats();
+    }
+
+    Stats &Stats::operator+=(const Stats &stats) {
+        n_vertices += stats.n_vertices;
+        n_shaded += stats.n_shaded;
+        return *this;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats) {
+        out << "shaded " << stats.n_shaded << " of " << stats.n_vertices << " vertices"
+            << " (vertex cache hit rate: " << 100.0f * stats.hit_rate() << "%)";
+        return out;
+    }
+}
\ No newline at end of file
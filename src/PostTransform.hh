@@ -0,0 +1,85 @@
+#ifndef __POST_TRANSFORM_HH__
+#define __POST_TRANSFORM_HH__
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "Obj.hh"
+#include "Types.hh"
+#include "Parallel.hh"
+#include "Interpolation.hh"
+
+namespace PostTransform {
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Number of vertices read by triangle assembly, and of those that ran the vertex shader
+    // (i.e. the misses), so that hits are the vertices shared with a previously shaded face
+    struct Stats {
+        long n_vertices = 0; // 3 per face
+        long n_shaded = 0;
+
+        float hit_rate() const;
+
+        void clear();
+
+        Stats &operator+=(const Stats &stats);
+    };
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats);
+
+    ///////////////////////////////////////////////////////
+    /// Buffer ////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Post-transform vertex buffer: the vertex shader runs once on each unique vertex of a model
+    // (see Obj::Model::unique_vertex), and triangle assembly then reads its outputs from here
+    // obs.: ShaderT must have Varyings and VertexOutput types (with clip_coord and varyings members),
+    //       and a const vertex(attributes) that returns the latter, as the shaders in Shaders do
+    template <typename ShaderT>
+    class Buffer {
+        private:
+            std::vector<typename ShaderT::VertexOutput> _outputs; // indexed by unique vertex id
+
+        public:
+            // Runs the vertex shader on every unique vertex of model, in parallel,
+            // counting the vertices its faces will read in stats
+            void shade(const ShaderT &shader, Obj::Model &model, Parallel::Pool &pool, Stats &stats);
+
+            inline const typename ShaderT::VertexOutput &operator[](int id) const {
+                return _outputs[id];
+            }
+
+            // Assembles face iface of model, i.e. writes the varyings (and clip space positions)
+            // of its vertices to triangle
+            void assemble(
+                Obj::Model &model, int iface, Interpolation::Triangle<typename ShaderT::Varyings> &triangle
+            ) const {
+                for (int j = 0; j < 3; ++j) {
+                    const typename ShaderT::VertexOutput &output = _outputs[model.unique_vertex_id(iface, j)];
+                    triangle.varyings[j] = output.varyings;
+                    triangle.clip_coords[j] = output.clip_coord;
+                }
+            }
+    };
+
+    template <typename ShaderT>
+    void Buffer<ShaderT>::shade(const ShaderT &shader, Obj::Model &model, Parallel::Pool &pool, Stats &stats) {
+        static const int CHUNK_SIZE = 1024;
+        const int n_vertices = model.n_of_unique_vertices();
+        _outputs.resize(n_vertices);
+        pool.run((n_vertices + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](int chunk, int thread_id) {
+            const int end = std::min(n_vertices, (chunk + 1) * CHUNK_SIZE);
+            for (int i = chunk * CHUNK_SIZE; i < end; ++i)
+                _outputs[i] = shader.vertex(model.unique_vertex(i));
+        });
+
+        stats.n_vertices += 3 * model.n_of_faces();
+        stats.n_shaded += n_vertices;
+    }
+}
+
+#endif // __POST_TRANSFORM_HH__
\ No newline at end of file
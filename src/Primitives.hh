@@ -14,6 +14,8 @@ namespace Primitives {
         Types::Vec3f pos;    // v  : (x, y, z) ∈ [-1.0, 1.0], geometric position
         Types::Vec2f uv;     // vt : (u, v)    ∈ [-1.0, 1.0], UV texture coordinates
         Types::Vec3f normal; // vn : (i, j, k) ∈ [-1.0, 1.0], vertex normal
+        Types::Vec4f tangent; // (x, y, z) is the unit tangent (along which u increases), and w = ±1
+                              // is the handedness of the tangent basis, i.e. bitangent = w * cross(normal, tangent)
 
         Vertex() = delete;
 
@@ -29,10 +31,17 @@ namespace Primitives {
             , uv(uv)
             , normal(normal) { }
 
+        explicit Vertex(const Types::Vec3f &pos, const Types::Vec2f &uv, const Types::Vec3f &normal, const Types::Vec4f &tangent)
+            : pos(pos)
+            , uv(uv)
+            , normal(normal)
+            , tangent(tangent) { }
+
         Vertex(const Vertex &vert)
             : pos(vert.pos)
             , uv(vert.uv)
-            , normal(vert.normal) { }
+            , normal(vert.normal)
+            , tangent(vert.tangent) { }
     };
 
     ///////////////////////////////////////////////////////
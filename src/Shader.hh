@@ -7,7 +7,12 @@
 
 struct Shader {
     virtual ~Shader();
-    virtual Types::Vec3f vertex(int iface, int nthvert) = 0;
+    // Returns the vertex position in clip space (i.e. before the perspective divide),
+    // which is clipped and mapped to screen space by the pipeline
+    virtual Types::Vec4f vertex(int iface, int nthvert) = 0;
+    // Called once per triangle, after the varyings of its vertices are set and before any of its
+    // pixels are shaded, to compute values that are constant over it (e.g. its tangent basis)
+    virtual void setup_triangle() { }
     virtual bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) = 0;
 };
 
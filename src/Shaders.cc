@@ -1,5 +1,6 @@
 #include "Shaders.hh"
 
+#include "Math.hh"
 #include "Geometry.hh"
 
 using Types::Vec2f;
@@ -11,224 +12,452 @@ using Types::Mat3f;
 namespace Shaders {
 
     ///////////////////////////////////////////////////////
-    /// Flat Shader ///////////////////////////////////////
+    /// color helpers /////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    Types::Vec3f Flat::vertex(int iface, int nthvert) {
-        varying_normal[nthvert] = (
-           uniform_mvp_inv_T * Vec4f(uniform_model->normal(iface, nthvert), 0)
-        ).xyz();
+    // obs.: the quad helpers below do the same operations on each lane, so the colors are identical
 
-        varying_intensity[nthvert] = std::max(0.0f, dot(varying_normal[nthvert], uniform_light_direction));
+    // Channels of color
+    static inline Vec4f color4f(const TGAColor &color) {
+        return Vec4f(color.bgra[0], color.bgra[1], color.bgra[2], color.bgra[3]);
+    }
 
-        // convert object space to screen space
-        Vec4f screen_coord = uniform_viewport * (
-            uniform_mvp * Vec4f(uniform_model->position(iface, nthvert), 1)
-        ).homogenize();
-        assert(screen_coord.w == 1);
-        return screen_coord.xyz();
+    // Same as color4f, with the BGR channels decoded from sRGB (i.e. linear, but still in [0, 255])
+    static inline Vec4f linear_color4f(const TGAColor &color) {
+        return Vec4f(
+            Math::srgb8_to_linear(color.bgra[0]) * 255.0f, Math::srgb8_to_linear(color.bgra[1]) * 255.0f,
+            Math::srgb8_to_linear(color.bgra[2]) * 255.0f, color.bgra[3]
+        );
     }
 
-    bool Flat::fragment(Types::Vec3f frag_coord, TGAColor &frag_color) {
-        // interpolate values for the current pixel
-        Vec3f normal = Vec3f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].x, varying_normal[1].x, varying_normal[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].y, varying_normal[1].y, varying_normal[2].y)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].z, varying_normal[1].z, varying_normal[2].z))
-        ).normalize();
+    // Same as color * intensity (with TGAColor's operator*), but without truncating the channels
+    static inline Vec4f scaled(const Vec4f &color, float intensity) {
+        return color * std::min(std::max(intensity, 0.0f), 1.0f);
+    }
 
-        float intensity = std::max(0.0f, dot(normal, uniform_light_direction)); // the light is behind when values are negative
+#ifdef DRAW_QUADS
+    ///////////////////////////////////////////////////////
+    /// quad helpers //////////////////////////////////////
+    ///////////////////////////////////////////////////////
 
-        frag_color = uniform_color * intensity;
+    using Simd::Float4;
+    typedef Types::Vec3<Float4> Vec3f4;
 
-        return false; // signal that we won't discard this pixel
+    // Channels of the colors of each lane
+    static Simd::Color4 color4(const TGAColor colors[4]) {
+        Simd::Color4 result;
+        for (int c = 0; c < 4; ++c)
+            result.bgra[c] = _mm_setr_ps(colors[0].bgra[c], colors[1].bgra[c], colors[2].bgra[c], colors[3].bgra[c]);
+        return result;
     }
 
+    // Same as color4, with the BGR channels decoded from sRGB (i.e. linear, but still in [0, 255])
+    static Simd::Color4 linear_color4(const TGAColor colors[4]) {
+        Simd::Color4 result;
+        for (int c = 0; c < 3; ++c)
+            result.bgra[c] = _mm_mul_ps(_mm_setr_ps(
+                Math::srgb8_to_linear(colors[0].bgra[c]), Math::srgb8_to_linear(colors[1].bgra[c]),
+                Math::srgb8_to_linear(colors[2].bgra[c]), Math::srgb8_to_linear(colors[3].bgra[c])
+            ), _mm_set1_ps(255.0f));
+        result.bgra[3] = _mm_setr_ps(colors[0].bgra[3], colors[1].bgra[3], colors[2].bgra[3], colors[3].bgra[3]);
+        return result;
+    }
+
+    // Same as colors * intensity (with TGAColor's operator*) on each lane
+    static void scale(Simd::Color4 &colors, Float4 intensity) {
+        intensity = Simd::clamp(intensity, _mm_setzero_ps(), _mm_set1_ps(1.0f));
+        for (int c = 0; c < 4; ++c)
+            colors.bgra[c] = _mm_mul_ps(colors.bgra[c], intensity);
+    }
+
+    // Differences of uv between the pixels of the quad along x and y (i.e. its screen space
+    // derivatives, from lane 0 to lane 1, and to lane 2), to select the mip level of textures
+    // obs.: every lane is interpolated (even those not in the quad's mask), so they're always defined
+    static void quad_derivatives(const Types::Vec2<Float4> &uv, Vec2f &duv_dx, Vec2f &duv_dy) {
+        alignas(16) float u[4], v[4];
+        _mm_store_ps(u, uv.x);
+        _mm_store_ps(v, uv.y);
+        duv_dx = Vec2f(u[1] - u[0], v[1] - v[0]);
+        duv_dy = Vec2f(u[2] - u[0], v[2] - v[0]);
+    }
+
+    // Runs fn(lane, uv) on each lane in mask, e.g. to sample textures (which isn't vectorized)
+    template <typename Fn>
+    static void for_each_lane(const Types::Vec2<Float4> &uv, int mask, Fn fn) {
+        alignas(16) float u[4], v[4];
+        _mm_store_ps(u, uv.x);
+        _mm_store_ps(v, uv.y);
+        for (int lane = 0; lane < 4; ++lane)
+            if (mask & (1 << lane))
+                fn(lane, Vec2f(u[lane], v[lane]));
+    }
+#endif
+
     ///////////////////////////////////////////////////////
-    /// Gouraud Shader ////////////////////////////////////
+    /// Flat Shader ///////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    Types::Vec3f Gouraud::vertex(int iface, int nthvert) {
-        varying_uv[nthvert] = uniform_model->uv(iface, nthvert);
-        varying_normal[nthvert] = (
-           uniform_mvp_inv_T * Vec4f(uniform_model->normal(iface, nthvert), 0)
+    Flat::VertexOutput Flat::vertex(const Primitives::Vertex &attributes) const {
+        VertexOutput output;
+        output.varyings.normal = (
+           uniform_mvp_inv_T * Vec4f(attributes.normal, 0)
         ).xyz();
 
-        varying_intensity[nthvert] = std::max(0.0f, dot(varying_normal[nthvert], uniform_light_direction));
-
         // convert object space to clip space through the ModelViewProjection transform
-        varying_clip_coord[nthvert] = uniform_mvp * Vec4f(uniform_model->position(iface, nthvert), 1);
+        output.clip_coord = uniform_mvp * Vec4f(attributes.pos, 1);
+        return output;
+    }
 
-        // convert clip space to NDC through perspective division
-        varying_ndc[nthvert] = varying_clip_coord[nthvert].homogenized();
+    bool Flat::fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Vec4f &frag_color) const {
+        Vec3f normal = interpolated.normal.normalized();
+        float intensity = std::max(0.0f, dot(normal, uniform_light_direction)); // the light is behind when values are negative
+        frag_color = scaled(color4f(uniform_color), intensity);
+        return false; // signal that we won't discard this pixel
+    }
 
-        // convert NDC to screen space through Viewport transform
-        Vec4f screen_coord = uniform_viewport * varying_ndc[nthvert];
-        assert(screen_coord.w == 1);
-        return screen_coord.xyz();
+#ifdef DRAW_QUADS
+    int Flat::fragment(
+        const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+    ) const {
+        Vec3f4 normal = Simd::normalized(interpolated.normal);
+        Float4 intensity = Simd::max(dot(normal, Simd::set1(uniform_light_direction)), _mm_setzero_ps());
+        const TGAColor colors[4] = { uniform_color, uniform_color, uniform_color, uniform_color };
+        frag_colors = color4(colors);
+        scale(frag_colors, intensity);
+        return 0; // signal that we won't discard any pixel
     }
+#endif
 
-    bool Gouraud::fragment(Types::Vec3f frag_coord, TGAColor &frag_color) {
-        // interpolate values for the current pixel
-        Vec2f uv = Vec2f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].x, varying_uv[1].x, varying_uv[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].y, varying_uv[1].y, varying_uv[2].y))
-        );
+    ///////////////////////////////////////////////////////
+    /// Gouraud Shader ////////////////////////////////////
+    ///////////////////////////////////////////////////////
 
-        float intensity = Geometry::barycentric_interp(frag_coord, varying_intensity);
-        intensity = std::max(0.0f, intensity); // the light is behind when values are negative
+    Gouraud::VertexOutput Gouraud::vertex(const Primitives::Vertex &attributes) const {
+        VertexOutput output;
+        output.varyings.uv = attributes.uv;
+        const Vec3f normal = (
+           uniform_mvp_inv_T * Vec4f(attributes.normal, 0)
+        ).xyz();
+        output.varyings.intensity = std::max(0.0f, dot(normal, uniform_light_direction));
 
-        frag_color = uniform_model->diffuse_map_at(uv) * intensity;
+        // convert object space to clip space through the ModelViewProjection transform
+        output.clip_coord = uniform_mvp * Vec4f(attributes.pos, 1);
+        return output;
+    }
 
+    bool Gouraud::fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Vec4f &frag_color) const {
+        float intensity = std::max(0.0f, interpolated.intensity); // the light is behind when values are negative
+        frag_color = scaled(color4f(uniform_model->diffuse_map_at(interpolated.uv)), intensity);
         return false; // signal that we won't discard this pixel
     }
 
+#ifdef DRAW_QUADS
+    int Gouraud::fragment(
+        const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+    ) const {
+        TGAColor colors[4];
+        for_each_lane(interpolated.uv, mask, [&](int lane, const Vec2f &uv) {
+            colors[lane] = uniform_model->diffuse_map_at(uv);
+        });
+        Float4 intensity = Simd::max(interpolated.intensity, _mm_setzero_ps());
+        frag_colors = color4(colors);
+        scale(frag_colors, intensity);
+        return 0; // signal that we won't discard any pixel
+    }
+#endif
+
     ///////////////////////////////////////////////////////
-    /// Texture Shader ////////////////////////////////////
+    /// Surface Shader ////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    Types::Vec3f Texture::vertex(int iface, int nthvert) {
-        varying_uv[nthvert] = uniform_model->uv(iface, nthvert);
-        varying_normal[nthvert] = (
-           uniform_mvp_inv_T * Vec4f(uniform_model->normal(iface, nthvert), 0)
-        ).xyz();
-
-        varying_intensity[nthvert] = std::max(0.0f, dot(varying_normal[nthvert], uniform_light_direction));
+    int maps_of(const Obj::Model &model) {
+        return (model.has_diffuse_map() ? DIFFUSE_MAP : 0)
+             | (model.has_normal_map() ? NORMAL_MAP : 0)
+             | (model.has_specular_map() ? SPECULAR_MAP : 0);
+    }
 
-        // convert object space to clip space through the ModelViewProjection transform
-        varying_clip_coord[nthvert] = uniform_mvp * Vec4f(uniform_model->position(iface, nthvert), 1);
+    // obs.: the tangent frame is only set (and read) by permutations with a normal map, so the helpers
+    //       below are overloaded on the (possibly empty) TangentVaryingsOf base of the varyings
 
-        // convert clip space to NDC through perspective division
-        varying_ndc[nthvert] = varying_clip_coord[nthvert].homogenized();
+    static inline void set_tangent(TangentVaryingsOf<float, false> &, const Vec4f &) { }
 
-        // convert NDC to screen space through Viewport transform
-        Vec4f screen_coord = uniform_viewport * varying_ndc[nthvert];
-        assert(screen_coord.w == 1);
-        return screen_coord.xyz();
+    static inline void set_tangent(TangentVaryingsOf<float, true> &varyings, const Vec4f &tangent) {
+        varyings.tangent = tangent;
     }
 
-    bool Texture::fragment(Types::Vec3f frag_coord, TGAColor &frag_color) {
-        // interpolate values for the current pixel
-        Vec2f uv = Vec2f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].x, varying_uv[1].x, varying_uv[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].y, varying_uv[1].y, varying_uv[2].y))
-        );
+    // Normal (in object space) of the surface with the interpolated normal, at uv
+    static inline Vec3f surface_normal(
+        const TangentVaryingsOf<float, false> &, const Vec3f &normal, const Vec2f &uv,
+        const Obj::Model *model, const Textures::Sampler &sampler, float lod
+    ) {
+        return normal.normalized();
+    }
 
-        Vec3f normal = Vec3f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].x, varying_normal[1].x, varying_normal[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].y, varying_normal[1].y, varying_normal[2].y)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_normal[0].z, varying_normal[1].z, varying_normal[2].z))
-        ).normalize();
-
-        // tangent space normal mapping
-        Mat3f A;
-        A.set_row(0, (varying_ndc[1] - varying_ndc[0]).xyz()); // B - A = AB
-        A.set_row(1, (varying_ndc[2] - varying_ndc[0]).xyz()); // C - A = AC
-        A.set_row(2, normal);
-
-        // compute the Darboux basis (i, j, normal)
-        Mat3f A_inv = A.inversed();
-        Vec3f i = A_inv * Vec3f(varying_uv[1].x - varying_uv[0].x, // B.u - A.u
-                                varying_uv[2].x - varying_uv[0].x, // C.u - A.u
-                                0).normalize();
-        Vec3f j = A_inv * Vec3f(varying_uv[1].y - varying_uv[0].y, // B.v - A.v
-                                varying_uv[2].y - varying_uv[0].y, // C.v - A.v
-                                0).normalize();
-        Mat3f B; // tangent basis
-        B.set_col(0, i);
-        B.set_col(0, j);
-        B.set_col(0, normal);
-
-        // change from tanget basis to global coordinates
-        Vec3f n = (B * uniform_model->normal_map_at(uv)).normalize();
-
-        float intensity = std::max(0.0f, dot(n, uniform_light_direction)); // the light is behind when values are negative
-        frag_color = uniform_model->diffuse_map_at(uv) * intensity;
+    static inline Vec3f surface_normal(
+        const TangentVaryingsOf<float, true> &frame, const Vec3f &interpolated_normal, const Vec2f &uv,
+        const Obj::Model *model, const Textures::Sampler &sampler, float lod
+    ) {
+        // tangent space normal mapping, with the (interpolated) per-vertex tangent basis,
+        // made orthonormal again (Gram-Schmidt), as interpolation doesn't keep it so
+        const Vec3f normal = interpolated_normal.normalized();
+        const Vec3f tangent = frame.tangent.xyz();
+        const float handedness = frame.tangent.w < 0.0f ? -1.0f : 1.0f;
+        const Vec3f i = (tangent - normal * dot(normal, tangent)).normalize();
+        const Vec3f j = cross(normal, i) * handedness;
+
+        // change from tangent basis to object space
+        const Vec3f n = model->normal_map_at(uv, sampler, lod);
+        return (i * n.x + j * n.y + normal * n.z).normalize();
+    }
 
-        return false; // signal that we won't discard this pixel
+#ifdef DRAW_QUADS
+    static inline Vec3f4 surface_normal(
+        const TangentVaryingsOf<Float4, false> &, const Vec3f4 &normal, const Types::Vec2<Float4> &uv,
+        int mask, const Obj::Model *model, const Textures::Sampler &sampler, float lod
+    ) {
+        return Simd::normalized(normal);
     }
 
-    ///////////////////////////////////////////////////////
-    /// Phong Shader //////////////////////////////////////
-    ///////////////////////////////////////////////////////
+    static inline Vec3f4 surface_normal(
+        const TangentVaryingsOf<Float4, true> &frame, const Vec3f4 &interpolated_normal,
+        const Types::Vec2<Float4> &uv, int mask, const Obj::Model *model, const Textures::Sampler &sampler, float lod
+    ) {
+        alignas(16) float normal_map[3][4] = {};
+        for_each_lane(uv, mask, [&](int lane, const Vec2f &lane_uv) {
+            const Vec3f n = model->normal_map_at(lane_uv, sampler, lod);
+            for (int k = 0; k < 3; ++k)
+                normal_map[k][lane] = n[k];
+        });
+
+        // obs.: the same operations as the scalar version above, on each lane
+        const Vec3f4 normal = Simd::normalized(interpolated_normal);
+        const Vec3f4 tangent = frame.tangent.xyz();
+        const Float4 handedness = Simd::select(
+            _mm_cmplt_ps(frame.tangent.w, _mm_setzero_ps()), _mm_set1_ps(-1.0f), _mm_set1_ps(1.0f)
+        );
+        const Vec3f4 i = Simd::normalized(tangent - normal * dot(normal, tangent));
+        const Vec3f4 j = cross(normal, i) * handedness;
 
-    Types::Vec3f Phong::vertex(int iface, int nthvert) {
-        varying_uv[nthvert] = uniform_model->uv(iface, nthvert);
-        varying_normal[nthvert] = (
-           uniform_mvp_inv_T * Vec4f(uniform_model->normal(iface, nthvert), 0)
-        ).xyz();
+        return Simd::normalized(
+            i * _mm_load_ps(normal_map[0]) + j * _mm_load_ps(normal_map[1]) + normal * _mm_load_ps(normal_map[2])
+        );
+    }
+#endif
+
+    template <Lighting LIGHTING, int MAPS>
+    typename Surface<LIGHTING, MAPS>::VertexOutput Surface<LIGHTING, MAPS>::vertex(
+        const Primitives::Vertex &attributes
+    ) const {
+        VertexOutput output;
+        output.varyings.uv = attributes.uv;
+        output.varyings.normal = attributes.normal;
+        set_tangent(output.varyings, attributes.tangent);
+        output.varyings.position = attributes.pos;
 
         // convert object space to clip space through the ModelViewProjection transform
-        varying_clip_coord[nthvert] = uniform_mvp * Vec4f(uniform_model->position(iface, nthvert), 1);
-
-        // convert clip space to NDC through perspective division
-        varying_ndc[nthvert] = varying_clip_coord[nthvert].homogenized();
-
-        // convert NDC to screen space through Viewport transform
-        Vec4f screen_coord = uniform_viewport * varying_ndc[nthvert];
-        assert(screen_coord.w == 1);
-        return screen_coord.xyz();
+        output.clip_coord = uniform_mvp * Vec4f(attributes.pos, 1);
+        return output;
     }
 
-    bool Phong::fragment(Types::Vec3f frag_coord, TGAColor &frag_color) {
-        // interpolate values for the current pixel
-        Vec2f uv = Vec2f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].x, varying_uv[1].x, varying_uv[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_uv[0].y, varying_uv[1].y, varying_uv[2].y))
+    template <Lighting LIGHTING, int MAPS>
+    bool Surface<LIGHTING, MAPS>::fragment(
+        const Varyings &interpolated, const Varyings &d_dx, const Varyings &d_dy,
+        const Types::Vec2i &frag_coord, Vec4f &frag_color
+    ) const {
+        const Vec2f &uv = interpolated.uv;
+        const float normal_lod = HAS_NORMAL_MAP ? uniform_model->normal_map().lod(d_dx.uv, d_dy.uv) : 0.0f;
+        const Vec3f object_normal = surface_normal(
+            interpolated, interpolated.normal, uv, uniform_model, uniform_sampler, normal_lod
         );
-
-        Vec3f normal = (
-           uniform_mvp_inv_T * Vec4f(uniform_model->normal_map_at(uv), 0)
+        const Vec3f normal = (
+           uniform_mvp_inv_T * Vec4f(object_normal, 0)
         ).xyz().normalize();
 
-        Vec3f light_dir = uniform_light_direction.normalized(); // make sure it's normalized
+        const float diffuse_lod = HAS_DIFFUSE_MAP ? uniform_model->diffuse_map().lod(d_dx.uv, d_dy.uv) : 0.0f;
+        const TGAColor tga_color = HAS_DIFFUSE_MAP ? uniform_model->diffuse_map_at(uv, uniform_sampler, diffuse_lod)
+                                                   : uniform_color;
+        const Vec4f color = uniform_linear ? linear_color4f(tga_color) : color4f(tga_color);
+        const float visibility = uniform_shadow_map != nullptr
+                               ? uniform_shadow_map->visibility(interpolated.position)
+                               : 1.0f;
 
+        Vec3f light_dir = uniform_light_direction.normalized(); // make sure it's normalized
         float intensity = dot(normal, light_dir);
-        Vec3f reflected_light_dir = (2 * intensity * normal - light_dir).normalize();
-
-        float spec = std::pow(std::max(0.0f, reflected_light_dir.z),
-                              uniform_model->specular_map_at(uv)); // material shininess
         float diff = std::max(0.0f, intensity); // the light is behind when values are negative
 
-        TGAColor color = uniform_model->diffuse_map_at(uv);
-        frag_color = color;
-        for (int i = 0; i < 3; i++) {
-            frag_color[i] = std::min(
-                uniform_ka + color[i] * (uniform_kd * diff + uniform_ks * spec),
-                255.0f
-            );
+        if (LIGHTING == Lighting::Lambert) {
+            frag_color = scaled(color, diff * visibility);
+            return false; // signal that we won't discard this pixel
         }
 
+        Vec3f reflected_light_dir = (2 * intensity * normal - light_dir).normalize();
+        const float specular_lod = HAS_SPECULAR_MAP ? uniform_model->specular_map().lod(d_dx.uv, d_dy.uv) : 0.0f;
+        const float shininess = HAS_SPECULAR_MAP ? uniform_model->specular_map_at(uv, uniform_sampler, specular_lod)
+                                                 : uniform_shininess;
+        float spec = std::pow(std::max(0.0f, reflected_light_dir.z), shininess);
+        spec *= visibility;
+        diff *= visibility;
+
+        // add up the (colored) light of the local lights that may reach the pixel, in object space
+        Vec3f local_light; // RGB
+        if (uniform_lights != nullptr) {
+            const Vec3f &position = interpolated.position;
+            const Vec3f to_eye = (uniform_eye - position).normalize();
+            for (int l : uniform_lights->lights_at(frag_coord)) {
+                const Lights::Light &light = uniform_lights->light(l);
+                Vec3f to_light;
+                const float attenuation = light.attenuation(position, to_light);
+                const float local_intensity = dot(object_normal, to_light);
+                if (attenuation <= 0.0f || local_intensity <= 0.0f)
+                    continue;
+
+                Vec3f reflected_to_light = 2 * local_intensity * object_normal - to_light;
+                float local_spec = std::pow(std::max(0.0f, dot(reflected_to_light, to_eye)), shininess);
+                local_light += light.color * (attenuation * (uniform_kd * local_intensity + uniform_ks * local_spec));
+            }
+        }
+
+        // obs.: values above 255 are saturated when written to an LDR framebuffer, and kept in an HDR one
+        const float light = uniform_kd * diff + uniform_ks * spec;
+        frag_color = color;
+        for (int i = 0; i < 3; i++)
+            frag_color[i] = uniform_ka + color[i] * (light + local_light[2 - i]); // BGR
         return false; // signal that we won't discard this pixel
     }
 
+#ifdef DRAW_QUADS
+    template <Lighting LIGHTING, int MAPS>
+    int Surface<LIGHTING, MAPS>::fragment(
+        const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+    ) const {
+        Vec2f duv_dx, duv_dy;
+        quad_derivatives(interpolated.uv, duv_dx, duv_dy);
+
+        TGAColor colors[4] = { uniform_color, uniform_color, uniform_color, uniform_color };
+        alignas(16) float specular_map[4] = { uniform_shininess, uniform_shininess, uniform_shininess, uniform_shininess };
+        if (HAS_DIFFUSE_MAP || HAS_SPECULAR_MAP) {
+            const float diffuse_lod = HAS_DIFFUSE_MAP ? uniform_model->diffuse_map().lod(duv_dx, duv_dy) : 0.0f;
+            const float specular_lod = HAS_SPECULAR_MAP ? uniform_model->specular_map().lod(duv_dx, duv_dy) : 0.0f;
+            for_each_lane(interpolated.uv, mask, [&](int lane, const Vec2f &uv) {
+                if (HAS_DIFFUSE_MAP)
+                    colors[lane] = uniform_model->diffuse_map_at(uv, uniform_sampler, diffuse_lod);
+                if (HAS_SPECULAR_MAP)
+                    specular_map[lane] = uniform_model->specular_map_at(uv, uniform_sampler, specular_lod);
+            });
+        }
+
+        // obs.: the (zero) w of the normal is left out of the product with uniform_mvp_inv_T
+        const float normal_lod = HAS_NORMAL_MAP ? uniform_model->normal_map().lod(duv_dx, duv_dy) : 0.0f;
+        const Vec3f4 object_normal = surface_normal(
+            interpolated, interpolated.normal, interpolated.uv, mask, uniform_model, uniform_sampler, normal_lod
+        );
+        Vec3f4 normal;
+        for (int i = 0; i < 3; ++i)
+            normal[i] = object_normal.x * Simd::set1(uniform_mvp_inv_T.cell(i, 0))
+                      + object_normal.y * Simd::set1(uniform_mvp_inv_T.cell(i, 1))
+                      + object_normal.z * Simd::set1(uniform_mvp_inv_T.cell(i, 2));
+        normal = Simd::normalized(normal);
+
+        const Float4 visibility = uniform_shadow_map != nullptr
+                                ? uniform_shadow_map->visibility(interpolated.position, mask)
+                                : Simd::set1(1.0f);
+
+        const Vec3f4 light_dir = Simd::set1(uniform_light_direction.normalized());
+        Float4 intensity = dot(normal, light_dir);
+        Float4 diff = Simd::max(intensity, _mm_setzero_ps()); // the light is behind when values are negative
+
+        frag_colors = uniform_linear ? linear_color4(colors) : color4(colors);
+        if (LIGHTING == Lighting::Lambert) {
+            scale(frag_colors, diff * visibility);
+            return 0; // signal that we won't discard any pixel
+        }
+
+        Vec3f4 reflected_light_dir = Simd::normalized(normal * (Simd::set1(2.0f) * intensity) - light_dir);
+        Float4 spec = Simd::pow(Simd::max(reflected_light_dir.z, _mm_setzero_ps()), _mm_load_ps(specular_map));
+        spec = spec * visibility;
+        diff = diff * visibility;
+
+        // add up the light of the local lights, looping over the list of the quad's tile once for all lanes
+        // obs.: lanes that no light reaches have zero attenuation, so they're left unchanged
+        Vec3f4 local_light(_mm_setzero_ps()); // RGB
+        if (uniform_lights != nullptr) {
+            const Vec3f4 &position = interpolated.position;
+            const Vec3f4 to_eye = Simd::normalized(Simd::set1(uniform_eye) - position);
+            for (int l : uniform_lights->lights_at(frag_coord)) {
+                const Lights::Light &light = uniform_lights->light(l);
+                Vec3f4 to_light;
+                const Float4 attenuation = light.attenuation(position, to_light);
+                const Float4 local_intensity = dot(object_normal, to_light);
+                const Float4 lit = _mm_and_ps(
+                    _mm_cmpgt_ps(attenuation, _mm_setzero_ps()), _mm_cmpgt_ps(local_intensity, _mm_setzero_ps())
+                );
+                if ((_mm_movemask_ps(lit) & mask) == 0)
+                    continue;
+
+                Vec3f4 reflected_to_light = object_normal * (Simd::set1(2.0f) * local_intensity) - to_light;
+                Float4 local_spec = Simd::pow(
+                    Simd::max(dot(reflected_to_light, to_eye), _mm_setzero_ps()), _mm_load_ps(specular_map)
+                );
+                const Float4 amount = _mm_and_ps(lit, attenuation * (
+                    Simd::set1(uniform_kd) * local_intensity + Simd::set1(uniform_ks) * local_spec
+                ));
+                local_light += Simd::set1(light.color) * amount;
+            }
+        }
+
+        // obs.: values above 255 are saturated when written to an LDR framebuffer, and kept in an HDR one
+        const Float4 light = Simd::set1(uniform_kd) * diff + Simd::set1(uniform_ks) * spec;
+        for (int i = 0; i < 3; i++)
+            frag_colors.bgra[i] = Simd::set1(uniform_ka) + frag_colors.bgra[i] * (light + local_light[2 - i]); // BGR
+        return 0; // signal that we won't discard any pixel
+    }
+#endif
+
     ///////////////////////////////////////////////////////
     /// Depth Shader //////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    Types::Vec3f Depth::vertex(int iface, int nthvert) {
+    Depth::VertexOutput Depth::vertex(const Primitives::Vertex &attributes) const {
+        VertexOutput output;
         // convert object space to clip space through the ModelViewProjection transform
-        varying_clip_coord[nthvert] = uniform_mvp * Vec4f(uniform_model->position(iface, nthvert), 1);
+        output.clip_coord = uniform_mvp * Vec4f(attributes.pos, 1);
+        output.varyings.z = output.clip_coord.z;
+        output.varyings.w = output.clip_coord.w;
+        return output;
+    }
 
-        // convert clip space to NDC through perspective division
-        varying_ndc[nthvert] = varying_clip_coord[nthvert].homogenized();
+    bool Depth::fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Vec4f &frag_color) const {
+        // obs.: z and w are interpolated with perspective correction, but z / w
+        //       (i.e. the depth in NDC) is linear in screen space, as it should be
+        float ndc_z = interpolated.z / interpolated.w;
+        frag_color = scaled(color4f(TGAColor(255, 255, 255)), ndc_z / uniform_depth_range);
+        return false; // signal that we won't discard this pixel
+    }
 
-        // convert NDC to screen space through Viewport transform
-        Vec4f screen_coord = uniform_viewport * varying_ndc[nthvert];
-        assert(screen_coord.w == 1);
-        return screen_coord.xyz();
+#ifdef DRAW_QUADS
+    int Depth::fragment(
+        const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+    ) const {
+        Float4 ndc_z = interpolated.z / interpolated.w;
+        const TGAColor white(255, 255, 255);
+        const TGAColor colors[4] = { white, white, white, white };
+        frag_colors = color4(colors);
+        scale(frag_colors, ndc_z / Simd::set1(uniform_depth_range));
+        return 0; // signal that we won't discard any pixel
     }
+#endif
+}
 
-    bool Depth::fragment(Types::Vec3f frag_coord, TGAColor &frag_color) {
-        // interpolate values for the current pixel
-        Vec3f ndc = Vec3f(
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_ndc[0].x, varying_ndc[1].x, varying_ndc[2].x)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_ndc[0].y, varying_ndc[1].y, varying_ndc[2].y)),
-            Geometry::barycentric_interp(frag_coord, Vec3f(varying_ndc[0].z, varying_ndc[1].z, varying_ndc[2].z))
-        );
+///////////////////////////////////////////////////////
+/// Draw::triangle instantiations /////////////////////
+///////////////////////////////////////////////////////
 
-        frag_color = TGAColor(255, 255, 255) * (ndc.z / uniform_depth_range);
+template SHADERS_TRIANGLE(Shaders::Flat);
+template SHADERS_TRIANGLE(Shaders::Gouraud);
+template SHADERS_TRIANGLE(Shaders::Depth);
 
-        return false; // signal that we won't discard this pixel
-    }
-}
\ No newline at end of file
+#define SHADERS_SURFACE(LIGHTING, MAPS) \
+    template struct Shaders::Surface<Shaders::Lighting::LIGHTING, MAPS>; \
+    template SHADERS_TRIANGLE(Shaders::Surface<Shaders::Lighting::LIGHTING, MAPS>);
+
+SHADERS_SURFACES(SHADERS_SURFACE)
\ No newline at end of file
@@ -4,151 +4,326 @@
 #include "tgaimage.hh"
 
 #include "Obj.hh"
+#include "Draw.hh"
 #include "Types.hh"
-#include "Shader.hh"
+#include "Simd.hh"
+#include "Lights.hh"
+#include "Shadows.hh"
+#include "Textures.hh"
+#include "Primitives.hh"
 
 namespace Shaders {
 
     // uniforms are constant values passed to the shader
     // varyings are written by the vertex shader, and read by the fragment shader
 
+    // Shaders only hold their uniforms, and are never written by the pipeline (all of their
+    // functions are const), so a single shader can be shared by every thread drawing with it:
+    // vertex(attributes) returns the values of the varyings of a vertex (VertexOutput), which
+    // the pipeline stores (see PostTransform) and assembles into the triangles it draws (see
+    // Interpolation::Triangle), i.e. varyings live in storage owned by the pipeline instead
+
+    // Each shader declares the varyings it interpolates once, in its Varyings struct, which
+    // fragment() is passed the (perspective correct) values of, as set up by Draw::triangle,
+    // along with the position of the pixel on the screen (frag_coord), and sets its BGRA color
+    // channels as floats, in [0, 255] (but only saturated when written to an LDR framebuffer)
+    // obs.: shaders that declare their Varyings as a template on the component type also have
+    //       a fragment() overload that shades a whole quad at once, in SoA form (QuadVaryings)
+
+    // obs.: they don't implement the (virtual) Shader interface, as Draw::triangle is
+    //       instantiated for each of them in Shaders.cc (see the end of this file),
+    //       where their fragment() is defined, and so can be inlined
+
     ///////////////////////////////////////////////////////
     /// Flat Shader ///////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    struct Flat : public Shader {
+    struct Flat {
+
+        template <typename T>
+        struct VaryingsOf {
+            Types::Vec3<T> normal;
+        };
+        typedef VaryingsOf<float> Varyings;
+#ifdef DRAW_QUADS
+        typedef VaryingsOf<Simd::Float4> QuadVaryings;
+#endif
 
-        Types::Vec3f vertex(int iface, int nthvert) override;
+        struct VertexOutput {
+            Types::Vec4f clip_coord;
+            Varyings varyings;
+        };
 
-        bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) override;
+        VertexOutput vertex(const Primitives::Vertex &attributes) const;
+
+        bool fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Types::Vec4f &frag_color) const;
+
+#ifdef DRAW_QUADS
+        int fragment(
+            const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+        ) const;
+#endif
 
         /// uniforms //////////////////////////////////////////
 
         Types::Mat4f uniform_mvp;
         Types::Mat4f uniform_mvp_inv_T;
-        Types::Mat4f uniform_viewport;
 
         Types::Vec3f uniform_light_direction;
-        Obj::Model *uniform_model;
+        const Obj::Model *uniform_model;
         TGAColor uniform_color = TGAColor(255, 255, 255, 255);
-
-        /// varyings //////////////////////////////////////////
-
-        Types::Vec3f varying_intensity; // float varying_intensity[3]
-        Types::Vec3f varying_normal[3];
     };
 
     ///////////////////////////////////////////////////////
     /// Gouraud Shader ////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    struct Gouraud : public Shader {
-
-        Types::Vec3f vertex(int iface, int nthvert) override;
-
-        bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) override;
-
-        /// uniforms //////////////////////////////////////////
-
-        Types::Mat4f uniform_mvp;
-        Types::Mat4f uniform_mvp_inv_T;
-        Types::Mat4f uniform_viewport;
+    struct Gouraud {
 
-        Types::Vec3f uniform_light_direction;
-        Obj::Model *uniform_model;
+        template <typename T>
+        struct VaryingsOf {
+            Types::Vec2<T> uv;
+            T intensity;
+        };
+        typedef VaryingsOf<float> Varyings;
+#ifdef DRAW_QUADS
+        typedef VaryingsOf<Simd::Float4> QuadVaryings;
+#endif
 
-        /// varyings //////////////////////////////////////////
+        struct VertexOutput {
+            Types::Vec4f clip_coord;
+            Varyings varyings;
+        };
 
-        Types::Vec2f varying_uv[3];
-        Types::Vec3f varying_intensity; // float varying_intensity[3]
-        Types::Vec3f varying_normal[3];
-        Types::Vec4f varying_clip_coord[3];
-        Types::Vec4f varying_ndc[3];
-    };
-
-    ///////////////////////////////////////////////////////
-    /// Texture Shader ////////////////////////////////////
-    ///////////////////////////////////////////////////////
+        VertexOutput vertex(const Primitives::Vertex &attributes) const;
 
-    struct Texture : public Shader {
+        bool fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Types::Vec4f &frag_color) const;
 
-        Types::Vec3f vertex(int iface, int nthvert) override;
-
-        bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) override;
+#ifdef DRAW_QUADS
+        int fragment(
+            const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+        ) const;
+#endif
 
         /// uniforms //////////////////////////////////////////
 
         Types::Mat4f uniform_mvp;
         Types::Mat4f uniform_mvp_inv_T;
-        Types::Mat4f uniform_viewport;
 
         Types::Vec3f uniform_light_direction;
-        Obj::Model *uniform_model;
-
-        /// varyings //////////////////////////////////////////
-
-        Types::Vec2f varying_uv[3];
-        Types::Vec3f varying_intensity; // float varying_intensity[3]
-        Types::Vec3f varying_normal[3];
-        Types::Vec4f varying_clip_coord[3];
-        Types::Vec4f varying_ndc[3];
+        const Obj::Model *uniform_model;
     };
 
     ///////////////////////////////////////////////////////
-    /// Phong Shader //////////////////////////////////////
+    /// Surface Shader ////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    struct Phong : public Shader {
+    // Maps (i.e. textures) of an Obj::Model that a Surface shader samples, as flags, which are fixed
+    // at compile time, so that a permutation without a map doesn't pay for it in its fragment()
+    enum Maps {
+        DIFFUSE_MAP  = 1 << 0, // color (otherwise uniform_color is used)
+        NORMAL_MAP   = 1 << 1, // tangent space normals (otherwise the vertices' normals are interpolated)
+        SPECULAR_MAP = 1 << 2, // shininess (otherwise uniform_shininess is used), which only Phong lighting uses
+        ALL_MAPS     = DIFFUSE_MAP | NORMAL_MAP | SPECULAR_MAP,
+    };
 
-        Types::Vec3f vertex(int iface, int nthvert) override;
+    // Maps that were loaded with model (see Obj::Model::load_texture)
+    int maps_of(const Obj::Model &model);
 
-        bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) override;
+    enum class Lighting {
+        Lambert, // diffuse light only
+        Phong,   // ambient, diffuse and specular light, also of the local lights (see Lights::Grid)
+    };
 
-        /// uniforms //////////////////////////////////////////
+    // Maps that a Surface shader with lighting samples
+    constexpr int used_maps(Lighting lighting) {
+        return lighting == Lighting::Phong ? ALL_MAPS : DIFFUSE_MAP | NORMAL_MAP;
+    }
 
+    // Uniforms of every permutation of Surface, so that they can be copied from one to another
+    struct SurfaceUniforms {
         Types::Mat4f uniform_mvp;
         Types::Mat4f uniform_mvp_inv_T;
-        Types::Mat4f uniform_viewport;
 
         float uniform_ka; // ambient reflection constant
         float uniform_kd; // diffuse reflection constant
         float uniform_ks; // specular reflection constant
+        // obs.: they're only used with Phong lighting
 
         Types::Vec3f uniform_light_direction;
-        Obj::Model *uniform_model;
+        const Obj::Model *uniform_model;
 
-        /// varyings //////////////////////////////////////////
+        // obs.: used in place of the maps that a permutation doesn't sample
+        TGAColor uniform_color = TGAColor(255, 255, 255, 255);
+        float uniform_shininess = 16.0f;
+
+        // obs.: when set, colors (i.e. the diffuse map's, or uniform_color) are decoded from sRGB, so that
+        //       light adds up linearly, as it should for an HDR framebuffer that's sRGB encoded by Tonemap
+        bool uniform_linear = false;
+
+        // obs.: the maps' mip levels are selected from the differences of uv between the pixels of each
+        //       quad (i.e. its derivatives), which the fragment() that shades a single pixel is also passed
+        Textures::Sampler uniform_sampler;
+
+        // obs.: the light in uniform_light_direction is only shadowed if this isn't null
+        const Shadows::Map *uniform_shadow_map = nullptr;
+
+        // obs.: local lights are only used (with Phong lighting) if uniform_lights isn't null,
+        //       in which case each pixel is lit by the ones in the list of its tile (see Lights::Grid)
+        const Lights::Grid *uniform_lights = nullptr;
+        Types::Vec3f uniform_eye; // camera position, in object space (as the lights)
+    };
+
+    // Varyings of the tangent frame, which only permutations with a normal map interpolate
+    // obs.: an empty base class takes no space, so the varyings still only have float members
+    template <typename T, bool HAS_NORMAL_MAP>
+    struct TangentVaryingsOf { };
 
-        Types::Vec2f varying_uv[3];
-        Types::Vec3f varying_normal[3];
-        Types::Vec4f varying_clip_coord[3];
-        Types::Vec4f varying_ndc[3];
+    template <typename T>
+    struct TangentVaryingsOf<T, true> {
+        Types::Vec4<T> tangent; // with the handedness of the tangent basis in w
     };
 
+    // Shades a surface with lighting, sampling the maps in MAPS from uniform_model, so a model should
+    // be drawn with the permutation that only has the maps it loaded (see with_maps_of)
+    template <Lighting LIGHTING, int MAPS>
+    struct Surface : SurfaceUniforms {
+
+        static const bool HAS_DIFFUSE_MAP = (MAPS & DIFFUSE_MAP) != 0;
+        static const bool HAS_NORMAL_MAP = (MAPS & NORMAL_MAP) != 0;
+        static const bool HAS_SPECULAR_MAP = (MAPS & SPECULAR_MAP) != 0;
+        static_assert((MAPS & ~used_maps(LIGHTING)) == 0, "MAPS must only have maps the lighting uses");
+
+        // obs.: normals and tangents are in object space, as the position (for the local lights and the shadow map)
+        template <typename T>
+        struct VaryingsOf : TangentVaryingsOf<T, HAS_NORMAL_MAP> {
+            Types::Vec2<T> uv;
+            Types::Vec3<T> normal;
+            Types::Vec3<T> position;
+        };
+        typedef VaryingsOf<float> Varyings;
+#ifdef DRAW_QUADS
+        typedef VaryingsOf<Simd::Float4> QuadVaryings;
+#endif
+
+        struct VertexOutput {
+            Types::Vec4f clip_coord;
+            Varyings varyings;
+        };
+
+        VertexOutput vertex(const Primitives::Vertex &attributes) const;
+
+        // obs.: d_dx and d_dy are the derivatives of the varyings (see Draw::Kernels::HasDerivatives)
+        bool fragment(
+            const Varyings &interpolated, const Varyings &d_dx, const Varyings &d_dy,
+            const Types::Vec2i &frag_coord, Types::Vec4f &frag_color
+        ) const;
+
+#ifdef DRAW_QUADS
+        int fragment(
+            const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+        ) const;
+#endif
+    };
+
+    typedef Surface<Lighting::Lambert, DIFFUSE_MAP | NORMAL_MAP> Texture;
+    typedef Surface<Lighting::Phong, ALL_MAPS> Phong;
+
+    // Calls fn(permutation), where permutation is the Surface shader with shader's lighting and
+    // uniforms, and only the maps of shader that model has (i.e. so it doesn't sample missing ones)
+    template <Lighting LIGHTING, int MAPS, typename Fn>
+    void with_maps_of(const Obj::Model &model, const Surface<LIGHTING, MAPS> &shader, Fn fn);
+
     ///////////////////////////////////////////////////////
     /// Depth Shader //////////////////////////////////////
     ///////////////////////////////////////////////////////
 
-    struct Depth : public Shader {
+    struct Depth {
+
+        template <typename T>
+        struct VaryingsOf {
+            T z; // in clip space
+            T w; // i.e. z / w is the depth in NDC
+        };
+        typedef VaryingsOf<float> Varyings;
+#ifdef DRAW_QUADS
+        typedef VaryingsOf<Simd::Float4> QuadVaryings;
+#endif
+
+        struct VertexOutput {
+            Types::Vec4f clip_coord;
+            Varyings varyings;
+        };
 
-        Types::Vec3f vertex(int iface, int nthvert) override;
+        VertexOutput vertex(const Primitives::Vertex &attributes) const;
 
-        bool fragment(Types::Vec3f frag_coord, TGAColor &frag_color) override;
+        bool fragment(const Varyings &interpolated, const Types::Vec2i &frag_coord, Types::Vec4f &frag_color) const;
+
+#ifdef DRAW_QUADS
+        int fragment(
+            const QuadVaryings &interpolated, const Types::Vec2i &frag_coord, int mask, Simd::Color4 &frag_colors
+        ) const;
+#endif
 
         /// uniforms //////////////////////////////////////////
 
         Types::Mat4f uniform_mvp;
         Types::Mat4f uniform_mvp_inv_T;
-        Types::Mat4f uniform_viewport;
 
-        Obj::Model *uniform_model;
+        const Obj::Model *uniform_model;
         float uniform_depth_range;
+    };
+}
 
-        /// varyings //////////////////////////////////////////
+#define SHADERS_TRIANGLE(...) \
+    void Draw::triangle<__VA_ARGS__>( \
+        Draw::TriangleProps<Types::Vec3f>, const __VA_ARGS__ &, \
+        const Interpolation::Triangle<__VA_ARGS__::Varyings> &, Frame::Buffer &, \
+        Types::Vec2i, HiZ::Pyramid *, Draw::DepthTest, const Types::Mat3f *, const Geometry::TriangleEdges * \
+    )
 
-        Types::Vec4f varying_clip_coord[3];
-        Types::Vec4f varying_ndc[3];
-    };
+// Calls X(lighting, maps) for each permutation of Surface, i.e. every subset of used_maps(lighting)
+#define SHADERS_SURFACES(X) \
+    X(Lambert, 0) X(Lambert, 1) X(Lambert, 2) X(Lambert, 3) \
+    X(Phong, 0) X(Phong, 1) X(Phong, 2) X(Phong, 3) X(Phong, 4) X(Phong, 5) X(Phong, 6) X(Phong, 7)
+
+#define SHADERS_EXTERN_SURFACE(LIGHTING, MAPS) \
+    extern template struct Shaders::Surface<Shaders::Lighting::LIGHTING, MAPS>; \
+    extern template SHADERS_TRIANGLE(Shaders::Surface<Shaders::Lighting::LIGHTING, MAPS>);
+
+extern template SHADERS_TRIANGLE(Shaders::Flat);
+extern template SHADERS_TRIANGLE(Shaders::Gouraud);
+extern template SHADERS_TRIANGLE(Shaders::Depth);
+SHADERS_SURFACES(SHADERS_EXTERN_SURFACE)
+
+namespace Shaders {
+
+    ///////////////////////////////////////////////////////
+    /// Surface permutations //////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Calls fn with the permutation of Surface with lighting, the uniforms of shader, and maps
+    template <Lighting LIGHTING, int MAPS, typename Fn>
+    inline void with_maps(const SurfaceUniforms &shader, Fn &fn) {
+        Surface<LIGHTING, MAPS> permutation;
+        static_cast<SurfaceUniforms &>(permutation) = shader;
+        fn(static_cast<const Surface<LIGHTING, MAPS> &>(permutation));
+    }
+
+    template <Lighting LIGHTING, int MAPS, typename Fn>
+    void with_maps_of(const Obj::Model &model, const Surface<LIGHTING, MAPS> &shader, Fn fn) {
+        // obs.: each case is masked by MAPS, so that the permutation never samples more maps than shader
+        switch (maps_of(model)) {
+            case 0: with_maps<LIGHTING, MAPS & 0>(shader, fn); break;
+            case 1: with_maps<LIGHTING, MAPS & 1>(shader, fn); break;
+            case 2: with_maps<LIGHTING, MAPS & 2>(shader, fn); break;
+            case 3: with_maps<LIGHTING, MAPS & 3>(shader, fn); break;
+            case 4: with_maps<LIGHTING, MAPS & 4>(shader, fn); break;
+            case 5: with_maps<LIGHTING, MAPS & 5>(shader, fn); break;
+            case 6: with_maps<LIGHTING, MAPS & 6>(shader, fn); break;
+            default: with_maps<LIGHTING, MAPS & 7>(shader, fn); break;
+        }
+    }
 }
 
 #endif // __SHADERS_HH__
\ No newline at end of file
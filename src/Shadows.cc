@@ -0,0 +1,109 @@
+#include "Shadows.hh"
+
+#include <algorithm>
+
+#include "Math.hh"
+#include "Shaders.hh"
+#include "Culling.hh"
+#include "Transform.hh"
+
+using Types::Vec2i;
+using Types::Vec3f;
+using Types::Mat4f;
+
+namespace Shadows {
+
+    // Radius of the sphere viewed by a light when the scene's is smaller (e.g. when there's no geometry)
+    static const float MIN_RADIUS = 1e-3f;
+
+    Mat4f directional_light_mvp(const Vec3f &light_direction, const Vec3f &center, float radius) {
+        radius = std::max(radius, MIN_RADIUS); // so that the view's eye isn't its center, nor the scale infinite
+        const Vec3f direction = light_direction.normalized();
+        const Vec3f up = std::abs(direction.y) < 0.99f ? Vec3f(0, 1, 0) : Vec3f(1, 0, 0);
+
+        // look at the sphere from the point of its surface closest to the light, so that its depths
+        // in view space are in [-2 * radius, 0], and then scale (and translate) them to [-1, 1]
+        return Transform::translate(Vec3f(0, 0, 1))
+             * Transform::scale(1.0f / radius)
+             * Transform::look_at(center + direction * radius, center, up);
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    void Stats::clear() {
+        *this = Stats();
+    }
+
+    Stats &Stats::operator+=(const Stats &stats) {
+        n_updates += stats.n_updates;
+        n_renders += stats.n_renders;
+        return *this;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats) {
+        out << "rendered the shadow map " << stats.n_renders << " times in "
+            << stats.n_updates << " updates";
+        return out;
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Map ///////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // obs.: faces facing away from the light are kept, as open models may only be closed by them
+    static Culling::Options culling_options() {
+        Culling::Options options;
+        options.back_faces = false;
+        return options;
+    }
+
+    Map::Map(int size, Parallel::Pool &pool, float bias)
+        : _size(size)
+        , _stride(size + 2 * BORDER)
+        , _bias(bias)
+        , _viewport(Transform::viewport(size, size, 1))
+        , _light_mvp()
+        , _to_map()
+        , _renderer(Vec2i(size, size), _viewport, pool, culling_options(), Frame::Format::Depth)
+        , _depth(_stride * _stride, Math::MIN_FLOAT)
+        , _generations()
+        , _is_valid(false)
+        , _stats() { }
+
+    bool Map::update(const Mat4f &light_mvp, const std::vector<Obj::Model *> &models) {
+        _stats.n_updates += 1;
+        std::vector<unsigned long> generations;
+        generations.reserve(models.size());
+        for (const Obj::Model *model : models)
+            generations.push_back(model->generation());
+        if (_is_valid && light_mvp == _light_mvp && generations == _generations)
+            return false;
+
+        _light_mvp = light_mvp;
+        _to_map = _viewport * light_mvp;
+        _generations = generations;
+        render(models);
+        _is_valid = true;
+        _stats.n_renders += 1;
+        return true;
+    }
+
+    void Map::invalidate() {
+        _is_valid = false;
+    }
+
+    void Map::render(const std::vector<Obj::Model *> &models) {
+        // obs.: only the vertex shader runs, as the renderer's depth only path never shades pixels
+        Shaders::Depth shader;
+        shader.uniform_mvp = _light_mvp;
+
+        _renderer.clear();
+        for (Obj::Model *model : models) {
+            shader.uniform_model = model;
+            _renderer.draw_depth(shader, *model);
+        }
+        _renderer.resolve_depth(&_depth[BORDER + BORDER * _stride], _stride);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#ifndef __SHADOWS_HH__
+#define __SHADOWS_HH__
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+#include "Obj.hh"
+#include "Simd.hh"
+#include "Types.hh"
+#include "Tiles.hh"
+#include "Parallel.hh"
+
+namespace Shadows {
+
+    // Transform from object space to the clip space of a directional light shining along direction
+    // (i.e. from the light towards the scene), which views the sphere (center, radius) orthographically
+    // obs.: as with the camera's, larger depths are closer to the light
+    // obs.: radius is clamped to a small minimum, so an empty scene (i.e. a radius of 0) is still valid
+    Types::Mat4f directional_light_mvp(const Types::Vec3f &direction, const Types::Vec3f &center, float radius);
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Number of times a shadow map was updated, and of those that had to render it again
+    struct Stats {
+        long n_updates = 0;
+        long n_renders = 0;
+
+        void clear();
+
+        Stats &operator+=(const Stats &stats);
+    };
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats);
+
+    ///////////////////////////////////////////////////////
+    /// Map ///////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Depth of the scene as seen from a light, which shaders sample to find whether a point is lit
+    // obs.: it's cached, i.e. only rendered again when the light or the models change, so that
+    //       moving the camera (e.g. in a turntable) doesn't cost another pass over the geometry
+    class Map {
+        private:
+            // Texels around the map, which the PCF kernel may read near its edges
+            static const int BORDER = 2;
+
+            int _size; // of each side, in texels
+            int _stride; // _size + 2 * BORDER
+            float _bias;
+
+            Types::Mat4f _viewport;
+            Types::Mat4f _light_mvp;
+            Types::Mat4f _to_map; // _viewport * _light_mvp
+
+            Tiles::Renderer _renderer;
+            std::vector<float> _depth; // in a linear layout (with a border that's never in shadow)
+
+            std::vector<unsigned long> _generations; // of the models the map was rendered with (see Obj::Model::generation)
+            bool _is_valid;
+
+            Stats _stats;
+
+            // Renders the depth of models from the light
+            void render(const std::vector<Obj::Model *> &models);
+
+            // Fraction of the 4x4 texels around texel (in the map's screen space) that are lit
+            inline float pcf(const Types::Vec3f &texel) const;
+
+        public:
+            // obs.: bias is added to the depth of each point before comparing it with the map's
+            //       (whose depths are in [0, 1]), to avoid surfaces shadowing themselves (acne)
+            Map(int size, Parallel::Pool &pool, float bias = 0.005f);
+
+            // Renders the map with the light's transform (see directional_light_mvp) and models,
+            // unless they're the same as the last time (i.e. have the same generations), returning true iff it was rendered
+            bool update(const Types::Mat4f &light_mvp, const std::vector<Obj::Model *> &models);
+
+            // Forces the next update to render the map again
+            void invalidate();
+
+            // Fraction of the light that reaches position (in object space), in [0, 1], filtered
+            // with PCF (i.e. percentage closer filtering) over 4x4 texels
+            inline float visibility(const Types::Vec3f &position) const {
+                const Types::Vec4f texel = _to_map * Types::Vec4f(position, 1);
+                return pcf(texel.xyz() * (1.0f / texel.w));
+            }
+
+#ifdef __SSE2__
+            // Same as above, for four positions at once (in SoA form), with lanes not in mask set to 1
+            inline Simd::Float4 visibility(const Types::Vec3<Simd::Float4> &position, int mask) const;
+#endif
+
+            const Stats &stats() const { return _stats; }
+    };
+
+    inline float Map::pcf(const Types::Vec3f &texel) const {
+        const int x = static_cast<int>(std::floor(texel.x));
+        const int y = static_cast<int>(std::floor(texel.y));
+        if (x < 0 || x >= _size || y < 0 || y >= _size)
+            return 1.0f; // outside of the map
+
+        // obs.: texels closer to the light than position + bias (i.e. with larger depths) shadow it
+        const float depth = texel.z + _bias;
+        const float *row = &_depth[(y - 1 + BORDER) * _stride + (x - 1 + BORDER)];
+        int n_lit = 0;
+#ifdef __SSE2__
+        // compare each row of 4 texels at once
+        const __m128 depth4 = _mm_set1_ps(depth);
+        for (int j = 0; j < 4; ++j, row += _stride)
+            n_lit += __builtin_popcount(_mm_movemask_ps(_mm_cmpge_ps(depth4, _mm_loadu_ps(row))));
+#else
+        for (int j = 0; j < 4; ++j, row += _stride)
+            for (int i = 0; i < 4; ++i)
+                n_lit += depth >= row[i];
+#endif
+        return n_lit * (1.0f / 16.0f);
+    }
+
+#ifdef __SSE2__
+    inline Simd::Float4 Map::visibility(const Types::Vec3<Simd::Float4> &position, int mask) const {
+        // transform the positions to the map's screen space at once, then filter each lane
+        alignas(16) float texels[4][4]; // x, y, z and w of each lane
+        for (int i = 0; i < 4; ++i) {
+            const Simd::Float4 value = position.x * Simd::set1(_to_map.cell(i, 0))
+                                     + position.y * Simd::set1(_to_map.cell(i, 1))
+                                     + position.z * Simd::set1(_to_map.cell(i, 2))
+                                     + Simd::set1(_to_map.cell(i, 3));
+            _mm_store_ps(texels[i], value);
+        }
+
+        alignas(16) float visibility[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (int lane = 0; lane < 4; ++lane) {
+            if (mask & (1 << lane)) {
+                const float inv_w = 1.0f / texels[3][lane];
+                visibility[lane] = pcf(Types::Vec3f(texels[0][lane], texels[1][lane], texels[2][lane]) * inv_w);
+            }
+        }
+        return _mm_load_ps(visibility);
+    }
+#endif
+}
+
+#endif // __SHADOWS_HH__
\ No newline at end of file
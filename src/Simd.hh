@@ -0,0 +1,144 @@
+#ifndef __SIMD_HH__
+#define __SIMD_HH__
+
+#include "Types.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+namespace Simd {
+
+    // Four float lanes, i.e. one value for each pixel of a quad (see Draw::Kernels::triangle_quads)
+    // obs.: it wraps __m128 (which converts to and from it, so it can be passed to intrinsics), as
+    //       the attributes of vector types are dropped when they're template arguments, and defines
+    //       the arithmetic operators, so that the Types vectors also work with Float4 components
+    //       (e.g. Types::Vec3<Float4> holds 4 Vec3f in SoA form)
+    struct Float4 {
+        __m128 v;
+
+        Float4() = default;
+        Float4(__m128 v) : v(v) { }
+
+        operator __m128() const { return v; }
+
+        Float4 operator-() const { return _mm_sub_ps(_mm_setzero_ps(), v); }
+
+        Float4 &operator+=(Float4 a) { v = _mm_add_ps(v, a.v); return *this; }
+        Float4 &operator-=(Float4 a) { v = _mm_sub_ps(v, a.v); return *this; }
+        Float4 &operator*=(Float4 a) { v = _mm_mul_ps(v, a.v); return *this; }
+        Float4 &operator/=(Float4 a) { v = _mm_div_ps(v, a.v); return *this; }
+    };
+
+    inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+
+    ///////////////////////////////////////////////////////
+    /// common functions //////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    inline Float4 set1(float a) { return _mm_set1_ps(a); }
+
+    inline Types::Vec3<Float4> set1(const Types::Vec3f &v) {
+        return Types::Vec3<Float4>(_mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z));
+    }
+
+    inline Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+    inline Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+
+    inline Float4 clamp(Float4 val, Float4 min_val, Float4 max_val) {
+        return _mm_min_ps(_mm_max_ps(val, min_val), max_val);
+    }
+
+    // Lanes of a where mask is set, and of b elsewhere
+    inline Float4 select(Float4 mask, Float4 a, Float4 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // obs.: the same operations (in the same order) as Vec3f::normalized, so the results are identical
+    inline Types::Vec3<Float4> normalized(const Types::Vec3<Float4> &v) {
+        const Float4 inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(Types::dot(v, v)));
+        return v * inv_length;
+    }
+
+    ///////////////////////////////////////////////////////
+    /// exponentials //////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // ref.: polynomials from the Cephes library's logf and exp2f (with relative errors around 1e-7)
+
+    // Base 2 logarithm of x > 0
+    inline Float4 log2(Float4 x) {
+        // x = m * 2^e, with m in [sqrt(0.5), sqrt(2))
+        const __m128i bits = _mm_castps_si128(_mm_max_ps(x, _mm_set1_ps(1.17549435e-38f))); // min. normal
+        __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+        Float4 m = _mm_castsi128_ps(_mm_or_si128(
+            _mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)
+        )); // in [1, 2)
+        const Float4 is_large = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+        m = select(is_large, _mm_mul_ps(m, _mm_set1_ps(0.5f)), m);
+        e = _mm_sub_epi32(e, _mm_castps_si128(is_large)); // i.e. + 1 where the mask (-1) is set
+
+        // ln(m) = f - f^2 / 2 + f^3 * P(f), with f = m - 1
+        const Float4 f = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+        const Float4 f2 = _mm_mul_ps(f, f);
+        Float4 p = _mm_set1_ps(7.0376836292e-2f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(-1.1514610310e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.1676998740e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(-1.2420140846e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.4249322787e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(-1.6668057665e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.0000714765e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(-2.4999993993e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(3.3333331174e-1f));
+        const Float4 ln_m = _mm_add_ps(
+            f, _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(p, f), f2), _mm_mul_ps(f2, _mm_set1_ps(0.5f)))
+        );
+
+        return _mm_add_ps(_mm_mul_ps(ln_m, _mm_set1_ps(1.44269504f)), _mm_cvtepi32_ps(e)); // log2(e) = 1 / ln(2)
+    }
+
+    // 2^x, for x in [-126, 127] (and clamped to it otherwise)
+    inline Float4 exp2(Float4 x) {
+        x = clamp(x, _mm_set1_ps(-126.0f), _mm_set1_ps(127.0f));
+
+        // 2^x = 2^i * 2^f, with i = round(x) and f in [-0.5, 0.5]
+        const __m128i i = _mm_cvtps_epi32(x);
+        const Float4 f = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+        Float4 p = _mm_set1_ps(1.535336188319500e-4f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.339887440266574e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+        const Float4 exp2_f = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+        // multiply by 2^i by adding i to the exponent bits
+        return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(exp2_f), _mm_slli_epi32(i, 23)));
+    }
+
+    // x^y for x >= 0, as std::pow (e.g. 0^0 = 1)
+    inline Float4 pow(Float4 x, Float4 y) {
+        const Float4 zero = _mm_setzero_ps();
+        const Float4 result = exp2(_mm_mul_ps(y, log2(x)));
+        return select(
+            _mm_cmpgt_ps(x, zero), result,
+            _mm_and_ps(_mm_cmpeq_ps(y, zero), _mm_set1_ps(1.0f)) // 0^y = 0, unless y = 0
+        );
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Color4 ////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Colors of four pixels, with BGRA channels (as TGAColor's) in [0, 255], which are truncated to unsigned
+    // chars when written to LDR framebuffers (also as TGAColor's, but saturated), and kept as is in HDR ones
+    struct Color4 {
+        Float4 bgra[4];
+    };
+}
+
+#endif // __SSE2__
+
+#endif // __SIMD_HH__
\ No newline at end of file
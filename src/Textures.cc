@@ -0,0 +1,216 @@
+#include "Textures.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+namespace Textures {
+
+    ///////////////////////////////////////////////////////
+    /// Texture ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    const unsigned char Texture::MORTON_BITS[TILE_SIZE] = {
+        0x0, 0x1, 0x4, 0x5
+    };
+
+    Texture::Level Texture::tiled(const std::vector<unsigned char> &texels, int width, int height) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.n_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+        const int n_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+        // over-allocate a cache line, to align the first tile to one
+        level.texels.resize(4 * level.n_tiles_x * n_tiles_y * TILE_TEXELS + CACHE_LINE);
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(level.texels.data());
+        level.offset = static_cast<int>((CACHE_LINE - address % CACHE_LINE) % CACHE_LINE);
+
+        // obs.: texels in the padding are never read, as samples wrap into [0, width) x [0, height)
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                std::copy_n(&texels[4 * (x + y * width)], 4, &level.texels[level.index(x, y)]);
+        return level;
+    }
+
+    long Texture::bytes() const {
+        long result = 0;
+        for (const Level &level : _levels)
+            result += static_cast<long>(level.texels.size());
+        return result;
+    }
+
+    Texture::Texture(const TGAImage &image) {
+        if (image.get_width() <= 0 || image.get_height() <= 0)
+            return; // i.e. it wasn't loaded
+
+        // the mip chain is built in a row-major layout, and each level is then tiled
+        int width = image.get_width();
+        int height = image.get_height();
+        std::vector<unsigned char> texels(4 * width * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const TGAColor color = image.get(x, y);
+                std::copy(color.bgra, color.bgra + 4, &texels[4 * (x + y * width)]);
+            }
+        }
+        _levels.push_back(tiled(texels, width, height));
+
+        // box filter each level into the next, until it's 1x1
+        // obs.: the last row (or column) of a level with an odd size is folded into the last texels of the
+        //       next one, which then average 3 rows (or columns), so that every texel contributes to it
+        while (width > 1 || height > 1) {
+            const int next_width = std::max(width / 2, 1);
+            const int next_height = std::max(height / 2, 1);
+            std::vector<unsigned char> next(4 * next_width * next_height);
+
+            for (int y = 0; y < next_height; ++y) {
+                const int y0 = 2 * y;
+                const int y1 = y == next_height - 1 ? height - 1 : 2 * y + 1;
+                for (int x = 0; x < next_width; ++x) {
+                    const int x0 = 2 * x;
+                    const int x1 = x == next_width - 1 ? width - 1 : 2 * x + 1;
+                    const int n_texels = (x1 - x0 + 1) * (y1 - y0 + 1);
+
+                    int sums[4] = { 0, 0, 0, 0 };
+                    for (int ty = y0; ty <= y1; ++ty)
+                        for (int tx = x0; tx <= x1; ++tx)
+                            for (int c = 0; c < 4; ++c)
+                                sums[c] += texels[4 * (tx + ty * width) + c];
+
+                    unsigned char *out = &next[4 * (x + y * next_width)];
+                    for (int c = 0; c < 4; ++c)
+                        out[c] = static_cast<unsigned char>((sums[c] + n_texels / 2) / n_texels); // rounded
+                }
+            }
+
+            texels.swap(next);
+            width = next_width;
+            height = next_height;
+            _levels.push_back(tiled(texels, width, height));
+        }
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    void Stats::clear() {
+        *this = Stats();
+    }
+
+    Stats &Stats::operator+=(const Stats &stats) {
+        n_hits += stats.n_hits;
+        n_misses += stats.n_misses;
+        n_failures += stats.n_failures;
+        n_evictions += stats.n_evictions;
+        bytes_resident += stats.bytes_resident;
+        return *this;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats) {
+        out << "loaded " << stats.n_hits + stats.n_misses << " textures"
+            << " (hits: " << stats.n_hits
+            << ", misses: " << stats.n_misses
+            << ", failures: " << stats.n_failures
+            << ", evictions: " << stats.n_evictions
+            << ", resident: " << stats.bytes_resident / 1024 << "KiB)";
+        return out;
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Cache /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Cache::Cache(long budget)
+        : _budget(budget)
+        , _mutex()
+        , _entries()
+        , _lru()
+        , _stats() { }
+
+    Handle Cache::load(const std::string &path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        char canonical_path[PATH_MAX];
+        struct stat file;
+        if (realpath(path.c_str(), canonical_path) == nullptr || stat(canonical_path, &file) != 0) {
+            _stats.n_misses += 1;
+            _stats.n_failures += 1;
+            return nullptr;
+        }
+
+        auto found = _entries.find(canonical_path);
+        if (found != _entries.end()) {
+            Entry &entry = found->second;
+            if (entry.modification_time == file.st_mtime) {
+                _lru.splice(_lru.begin(), _lru, entry.lru); // i.e. move it to the front
+                _stats.n_hits += 1;
+                return entry.texture;
+            }
+
+            // the file changed, so its entry is dropped (though handles to it are still valid)
+            _stats.bytes_resident -= entry.bytes;
+            _lru.erase(entry.lru);
+            _entries.erase(found);
+        }
+
+        _stats.n_misses += 1;
+        TGAImage image;
+        if (!image.read_tga_file(canonical_path)) {
+            _stats.n_failures += 1;
+            return nullptr;
+        }
+        image.flip_vertically();
+
+        Handle texture = std::make_shared<const Texture>(image);
+        _lru.push_front(canonical_path);
+        _entries[canonical_path] = Entry{ texture, file.st_mtime, texture->bytes(), _lru.begin() };
+        _stats.bytes_resident += texture->bytes();
+        evict();
+        return texture;
+    }
+
+    void Cache::evict() {
+        // obs.: a texture is unreferenced when the cache holds its only handle
+        auto it = _lru.end();
+        while (_stats.bytes_resident > _budget && it != _lru.begin()) {
+            --it;
+            auto found = _entries.find(*it);
+            if (found->second.texture.use_count() > 1)
+                continue;
+
+            _stats.bytes_resident -= found->second.bytes;
+            _stats.n_evictions += 1;
+            _entries.erase(found);
+            it = _lru.erase(it);
+        }
+    }
+
+    void Cache::set_budget(long budget) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _budget = budget;
+        evict();
+    }
+
+    void Cache::trim() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const long budget = _budget;
+        _budget = 0;
+        evict();
+        _budget = budget;
+    }
+
+    Stats Cache::stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    Cache &cache() {
+        static Cache process_cache; // obs.: constructed on first use, which is thread safe
+        return process_cache;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,288 @@
+#ifndef __TEXTURES_HH__
+#define __TEXTURES_HH__
+
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+
+#include "tgaimage.hh"
+
+#include "Math.hh"
+#include "Types.hh"
+
+namespace Textures {
+
+    ///////////////////////////////////////////////////////
+    /// Sampler ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    enum class Filter {
+        Nearest,   // closest texel of the closest mip level
+        Bilinear,  // 2x2 closest texels of the closest mip level
+        Trilinear, // 2x2 closest texels of the two closest mip levels
+    };
+
+    // How uv coordinates outside of [0, 1] are mapped to the texture
+    enum class Wrap {
+        Repeat, // tile it
+        Clamp,  // stretch its edges
+        Mirror, // tile it, flipping every other copy
+    };
+
+    struct Sampler {
+        Filter filter = Filter::Trilinear;
+        Wrap wrap = Wrap::Repeat;
+
+        Sampler() = default;
+
+        Sampler(Filter filter, Wrap wrap)
+            : filter(filter)
+            , wrap(wrap) { }
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Texture ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Texels are stored in TILE_SIZE x TILE_SIZE tiles, in row-major order, and in Morton (Z) order
+    // inside of each tile, so that a tile of 4 byte texels is a single (aligned) 64B cache line, and
+    // texels that are close in both u and v (e.g. the 2x2 of a bilinear sample) are close in memory,
+    // whichever direction a triangle's uv goes across the screen (unlike in TGAImage's row-major one)
+    static const int TILE_SIZE = 4;
+    static const int TILE_TEXELS = TILE_SIZE * TILE_SIZE;
+    static const int CACHE_LINE = 64; // bytes
+
+    // Image with its mip chain (i.e. copies of it with half the size of the previous one, down to
+    // 1x1), built when it's loaded, so that minified samples read a small level (and stay in cache)
+    // obs.: texels are stored with 4 BGRA channels (as TGAColor's), with missing ones set to zero
+    class Texture {
+        private:
+            struct Level {
+                int width;
+                int height;
+                int n_tiles_x; // number of tile columns (i.e. the width, rounded up, in tiles)
+                std::vector<unsigned char> texels; // in the tiled layout above (padded to whole tiles)
+                int offset; // of the first texel in texels, which is aligned to a cache line
+
+                // Position of the channels of texel (x, y) in texels
+                inline int index(int x, int y) const {
+                    const int tile = (x / TILE_SIZE) + (y / TILE_SIZE) * n_tiles_x;
+                    return offset + 4 * (
+                        tile * TILE_TEXELS + (MORTON_BITS[x % TILE_SIZE] | (MORTON_BITS[y % TILE_SIZE] << 1))
+                    );
+                }
+            };
+
+            std::vector<Level> _levels;
+
+            // Bits of a coordinate inside of a tile, spread to the even bits of its Morton code
+            static const unsigned char MORTON_BITS[TILE_SIZE];
+
+            // Level with the (row-major) texels of an image with width and height, in the tiled layout
+            static Level tiled(const std::vector<unsigned char> &texels, int width, int height);
+
+            // Channels of the texel (x, y) of level, which wraps them into it
+            inline const unsigned char *texel(const Level &level, Wrap wrap, int x, int y) const {
+                x = wrapped(x, level.width, wrap);
+                y = wrapped(y, level.height, wrap);
+                return &level.texels[level.index(x, y)];
+            }
+
+            // Bilinear sample of level at uv
+            inline Types::Vec4f bilinear(const Level &level, Wrap wrap, const Types::Vec2f &uv) const;
+
+            static inline int wrapped(int i, int size, Wrap wrap);
+
+        public:
+            // obs.: an empty texture samples as black (as an empty TGAImage)
+            Texture() = default;
+
+            explicit Texture(const TGAImage &image);
+
+            bool empty() const { return _levels.empty(); }
+            int n_levels() const { return static_cast<int>(_levels.size()); }
+            int width() const { return empty() ? 0 : _levels[0].width; }
+            int height() const { return empty() ? 0 : _levels[0].height; }
+
+            // Memory taken by the texels of every level
+            long bytes() const;
+
+            // Level of detail of a pixel whose uv changes by duv_dx and duv_dy to its neighbors along
+            // x and y on the screen, i.e. the log2 of the number of texels it covers (along its longest axis)
+            inline float lod(const Types::Vec2f &duv_dx, const Types::Vec2f &duv_dy) const {
+                if (empty())
+                    return 0.0f;
+                const Types::Vec2f size(static_cast<float>(_levels[0].width), static_cast<float>(_levels[0].height));
+                const Types::Vec2f dx(duv_dx.x * size.x, duv_dx.y * size.y);
+                const Types::Vec2f dy(duv_dy.x * size.x, duv_dy.y * size.y);
+                const float rho_squared = Math::max(dot(dx, dx), dot(dy, dy));
+                return rho_squared > 1.0f ? 0.5f * std::log2(rho_squared) : 0.0f; // i.e. log2(rho)
+            }
+
+            // Channels of the texture at uv (in BGRA order, in [0, 255]), filtered at lod by sampler
+            inline Types::Vec4f sample(const Sampler &sampler, const Types::Vec2f &uv, float lod = 0.0f) const;
+    };
+
+    inline int Texture::wrapped(int i, int size, Wrap wrap) {
+        if (static_cast<unsigned int>(i) < static_cast<unsigned int>(size))
+            return i; // i.e. 0 <= i < size, which is the common case
+        switch (wrap) {
+            case Wrap::Repeat:
+                i %= size;
+                return i < 0 ? i + size : i;
+            case Wrap::Clamp:
+                return i < 0 ? 0 : size - 1;
+            case Wrap::Mirror:
+            default:
+                i %= 2 * size;
+                if (i < 0)
+                    i += 2 * size;
+                return i < size ? i : 2 * size - 1 - i;
+        }
+    }
+
+    inline Types::Vec4f Texture::bilinear(const Level &level, Wrap wrap, const Types::Vec2f &uv) const {
+        // texel centers are at their index + 0.5
+        const float s = uv.x * level.width - 0.5f;
+        const float t = uv.y * level.height - 0.5f;
+        const float x0 = std::floor(s);
+        const float y0 = std::floor(t);
+        const float tx = s - x0;
+        const float ty = t - y0;
+        const int x = static_cast<int>(x0);
+        const int y = static_cast<int>(y0);
+
+        const unsigned char *t00 = texel(level, wrap, x, y);
+        const unsigned char *t10 = texel(level, wrap, x + 1, y);
+        const unsigned char *t01 = texel(level, wrap, x, y + 1);
+        const unsigned char *t11 = texel(level, wrap, x + 1, y + 1);
+
+        Types::Vec4f result;
+        for (int c = 0; c < 4; ++c) {
+            const float top = Math::lerp(static_cast<float>(t00[c]), static_cast<float>(t10[c]), tx);
+            const float bottom = Math::lerp(static_cast<float>(t01[c]), static_cast<float>(t11[c]), tx);
+            result[c] = Math::lerp(top, bottom, ty);
+        }
+        return result;
+    }
+
+    inline Types::Vec4f Texture::sample(const Sampler &sampler, const Types::Vec2f &uv, float lod) const {
+        if (empty())
+            return Types::Vec4f();
+
+        const int last_level = n_levels() - 1;
+        lod = Math::clamp(lod, 0.0f, static_cast<float>(last_level));
+
+        switch (sampler.filter) {
+            case Filter::Nearest: {
+                const Level &level = _levels[static_cast<int>(lod + 0.5f)];
+                const unsigned char *c = texel(
+                    level, sampler.wrap,
+                    static_cast<int>(std::floor(uv.x * level.width)),
+                    static_cast<int>(std::floor(uv.y * level.height))
+                );
+                return Types::Vec4f(c[0], c[1], c[2], c[3]);
+            }
+
+            case Filter::Bilinear:
+                return bilinear(_levels[static_cast<int>(lod + 0.5f)], sampler.wrap, uv);
+
+            case Filter::Trilinear:
+            default: {
+                const int i = static_cast<int>(lod);
+                const float t = lod - i;
+                const Types::Vec4f finer = bilinear(_levels[i], sampler.wrap, uv);
+                if (t == 0.0f)
+                    return finer;
+                const Types::Vec4f coarser = bilinear(_levels[std::min(i + 1, last_level)], sampler.wrap, uv);
+                return finer * (1.0f - t) + coarser * t;
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Stats /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Number of textures loaded through a Cache that were already in it (hits), or that had to be
+    // decoded (misses), and of those evicted from it to stay in its budget, with its current size
+    struct Stats {
+        long n_hits = 0;
+        long n_misses = 0;
+        long n_failures = 0; // i.e. files that couldn't be read (which are also misses)
+        long n_evictions = 0;
+        long bytes_resident = 0;
+
+        void clear();
+
+        Stats &operator+=(const Stats &stats);
+    };
+
+    std::ostream &operator<<(std::ostream &out, const Stats &stats);
+
+    ///////////////////////////////////////////////////////
+    /// Cache /////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Shared (immutable) texture, which stays in the Cache it was loaded from while it's referenced
+    typedef std::shared_ptr<const Texture> Handle;
+
+    // Textures loaded from TGA files, keyed by their canonical path (so different paths to the same
+    // file share it) and modification time (so an edited file is loaded again), so that models that
+    // share a texture (or the same model, loaded again) don't decode it, nor keep copies of it
+    // obs.: textures that aren't referenced (i.e. only by the cache) are kept until the cache goes
+    //       over its budget, when they're evicted in least recently used order
+    // obs.: it's thread safe, but textures are loaded while holding its lock
+    class Cache {
+        private:
+            struct Entry {
+                Handle texture;
+                time_t modification_time;
+                long bytes;
+                std::list<std::string>::iterator lru; // position in _lru
+            };
+
+            long _budget; // in bytes
+
+            std::mutex _mutex;
+            std::unordered_map<std::string, Entry> _entries; // by canonical path
+            std::list<std::string> _lru; // paths, from the most to the least recently used
+
+            Stats _stats;
+
+            // Evicts unreferenced textures, from the least recently used, until the cache fits its budget
+            // obs.: assumes _mutex is locked
+            void evict();
+
+        public:
+            static const long DEFAULT_BUDGET = 256L * 1024 * 1024; // 256MiB
+
+            explicit Cache(long budget = DEFAULT_BUDGET);
+
+            Cache(const Cache &) = delete;
+            Cache &operator=(const Cache &) = delete;
+
+            // Texture of the TGA file at path (flipped vertically, so that uv (0, 0) is its bottom
+            // left corner), decoding it only if it isn't cached, or if the file changed since it was
+            // obs.: returns null if the file can't be read
+            Handle load(const std::string &path);
+
+            // Sets the budget, evicting textures to fit it (as far as the referenced ones allow)
+            void set_budget(long budget);
+
+            // Evicts every texture that isn't referenced
+            void trim();
+
+            Stats stats();
+    };
+
+    // Cache shared by the whole process (e.g. by every Obj::Model)
+    Cache &cache();
+}
+
+#endif // __TEXTURES_HH__
\ No newline at end of file
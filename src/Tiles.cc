@@ -0,0 +1,155 @@
+#include "Tiles.hh"
+
+#include <algorithm>
+
+using Types::Vec2i;
+using Types::Vec3f;
+
+using Types::Mat4f;
+
+namespace Tiles {
+
+    // obs.: so that each light tile is covered by a single tile's framebuffer
+    static_assert(TILE_SIZE % Lights::TILE_SIZE == 0, "tiles must be made of whole light tiles");
+
+    ///////////////////////////////////////////////////////
+    /// Tile //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Tile::Tile(const Vec2i &origin, const Vec2i &size, Frame::Format format)
+        : origin(origin)
+        , framebuffer(size, format)
+        , hiz(size)
+        , bin() { }
+
+    void Tile::clear() {
+        framebuffer.clear();
+        hiz.clear();
+        bin.clear();
+    }
+
+    ///////////////////////////////////////////////////////
+    /// Renderer //////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    Renderer::Renderer(const Vec2i &resolution, const Mat4f &viewport,
+                       Parallel::Pool &pool,
+                       const Culling::Options &culling,
+                       Frame::Format format)
+        : _resolution(resolution)
+        , _viewport(viewport)
+        , _n_tiles((resolution.x + TILE_SIZE - 1) / TILE_SIZE,
+                   (resolution.y + TILE_SIZE - 1) / TILE_SIZE)
+        , _tiles()
+        , _clip_coords()
+        , _triangles()
+        , _chunks()
+        , _pool(pool)
+        , _culling(culling)
+        , _culling_stats()
+        , _vertex_stats() {
+        _tiles.reserve(_n_tiles.x * _n_tiles.y);
+        for (int ty = 0; ty < _n_tiles.y; ++ty) {
+            for (int tx = 0; tx < _n_tiles.x; ++tx) {
+                Vec2i origin(tx * TILE_SIZE, ty * TILE_SIZE);
+                Vec2i size(std::min(TILE_SIZE, resolution.x - origin.x), // tiles on the right and
+                           std::min(TILE_SIZE, resolution.y - origin.y)); // top borders may be smaller
+                _tiles.emplace_back(origin, size, format);
+            }
+        }
+    }
+
+    void Renderer::clear() {
+        _pool.run(static_cast<int>(_tiles.size()), [this](int itile, int thread_id) {
+            _tiles[itile].clear();
+        });
+    }
+
+    void Renderer::bin(int iface, Chunk &chunk) const {
+        Clipping::Triangle triangles[Clipping::MAX_TRIANGLES];
+        const int n_triangles = Clipping::clip(&_clip_coords[3 * iface], _viewport, triangles);
+
+        for (int k = 0; k < n_triangles; ++k) {
+            Geometry::TriangleEdges edges;
+            if (Culling::cull(triangles[k].screen_coords, _resolution, _culling, chunk.culling_stats, edges))
+                continue;
+
+            // same bounding box as in Draw::triangle, but clamped to the whole screen
+            if (!edges.is_in_guard_band || edges.is_degenerate)
+                continue;
+
+            const Vec2i bbox_min(std::max(0, edges.bbox_min.x), std::max(0, edges.bbox_min.y));
+            const Vec2i bbox_max(std::min(edges.bbox_max.x, _resolution.x - 1),
+                                 std::min(edges.bbox_max.y, _resolution.y - 1));
+            if (bbox_min.x > bbox_max.x || bbox_min.y > bbox_max.y)
+                continue; // off-screen (or not covering any pixel center)
+
+            const int itriangle = static_cast<int>(chunk.triangles.size());
+            chunk.triangles.push_back({ iface, triangles[k], edges });
+            for (int ty = bbox_min.y / TILE_SIZE; ty <= bbox_max.y / TILE_SIZE; ++ty)
+                for (int tx = bbox_min.x / TILE_SIZE; tx <= bbox_max.x / TILE_SIZE; ++tx)
+                    chunk.bins[tx + ty * _n_tiles.x].push_back(itriangle);
+        }
+    }
+
+    void Renderer::merge_chunks(int n_chunks, Culling::Stats &culling_stats) {
+        // index in _triangles of each chunk's first triangle
+        std::vector<int> offsets(n_chunks);
+        int n_triangles = 0;
+        for (int ichunk = 0; ichunk < n_chunks; ++ichunk) {
+            offsets[ichunk] = n_triangles;
+            n_triangles += static_cast<int>(_chunks[ichunk].triangles.size());
+            culling_stats += _chunks[ichunk].culling_stats;
+        }
+
+        _triangles.resize(n_triangles);
+        _pool.run(n_chunks, [&](int ichunk, int thread_id) {
+            std::copy(_chunks[ichunk].triangles.begin(), _chunks[ichunk].triangles.end(), _triangles.begin() + offsets[ichunk]);
+        });
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            std::vector<int> &bin = _tiles[itile].bin;
+            for (int ichunk = 0; ichunk < n_chunks; ++ichunk)
+                for (int k : _chunks[ichunk].bins[itile])
+                    bin.push_back(offsets[ichunk] + k);
+        });
+    }
+
+    void Renderer::cull_lights(Lights::Grid &grid) {
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            grid.cull(_tiles[itile].framebuffer, _tiles[itile].origin);
+        });
+    }
+
+    void Renderer::resolve(TGAImage &image) {
+        assert(image.get_width() == _resolution.x && image.get_height() == _resolution.y);
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            _tiles[itile].framebuffer.resolve(image, _tiles[itile].origin);
+        });
+    }
+
+    void Renderer::resolve_hdr(float *bgra, int stride) {
+        assert(stride >= _resolution.x);
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            _tiles[itile].framebuffer.resolve_hdr(bgra, stride, _tiles[itile].origin);
+        });
+    }
+
+    void Renderer::resolve_depth(float *depth, int stride) {
+        assert(stride >= _resolution.x);
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            _tiles[itile].framebuffer.resolve_depth(depth, stride, _tiles[itile].origin);
+        });
+    }
+
+    const Culling::Stats &Renderer::culling_stats() const {
+        return _culling_stats;
+    }
+
+    const PostTransform::Stats &Renderer::vertex_stats() const {
+        return _vertex_stats;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#ifndef __TILES_HH__
+#define __TILES_HH__
+
+#include <vector>
+
+#include "tgaimage.hh"
+
+#include "HiZ.hh"
+#include "Draw.hh"
+#include "Math.hh"
+#include "Frame.hh"
+#include "Types.hh"
+#include "Culling.hh"
+#include "Geometry.hh"
+#include "Lights.hh"
+#include "Clipping.hh"
+#include "Parallel.hh"
+#include "PostTransform.hh"
+
+namespace Tiles {
+
+    static const int TILE_SIZE = 64; // in pixels (so a tile's depth takes 16KB, in 8x8 Frame blocks)
+    static const int CHUNK_SIZE = 1024; // faces per task, when transforming and binning them in parallel
+
+    ///////////////////////////////////////////////////////
+    /// Tile //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Region of the screen with its own color and depth buffers,
+    // so that threads rasterizing different tiles never share memory
+    struct Tile {
+        Types::Vec2i origin; // screen position of the tile's (0, 0) pixel
+        Frame::Buffer framebuffer;
+        HiZ::Pyramid hiz;
+        std::vector<int> bin; // triangles whose bounding box overlaps the tile, in draw order
+
+        Tile(const Types::Vec2i &origin, const Types::Vec2i &size, Frame::Format format);
+
+        void clear();
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Renderer //////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Sort-middle renderer: faces are transformed, clipped and binned into the tiles
+    // their screen space bounding box overlaps, then tiles are rasterized in parallel
+    class Renderer {
+        private:
+            // Triangle binned into the tiles, i.e. a face (or part of it, if it was clipped),
+            // with its edges, as set up by culling (and then passed on to the rasterizer)
+            struct Triangle {
+                int iface;
+                Clipping::Triangle triangle;
+                Geometry::TriangleEdges edges;
+            };
+
+            // Triangles binned from a contiguous range of faces, by a single task, into bins of their own
+            // (with indices into triangles), which are then concatenated in order (see transform_and_bin)
+            struct Chunk {
+                std::vector<Triangle> triangles;
+                std::vector<std::vector<int>> bins; // one per tile
+                Culling::Stats culling_stats;
+            };
+
+            Types::Vec2i _resolution;
+            Types::Mat4f _viewport;
+            Types::Vec2i _n_tiles; // number of tile columns and rows
+
+            std::vector<Tile> _tiles;
+            std::vector<Types::Vec4f> _clip_coords; // of the faces being drawn (3 per face)
+            std::vector<Triangle> _triangles; // binned (indexed by Tile::bin)
+            std::vector<Chunk> _chunks; // kept between draws, so that their storage is reused
+
+            Parallel::Pool &_pool;
+
+            Culling::Options _culling;
+            Culling::Stats _culling_stats;
+            PostTransform::Stats _vertex_stats;
+
+            // Clips face iface, and adds what's left of it to chunk's bins of the tiles it overlaps,
+            // unless it's culled (counting it in chunk's culling_stats)
+            void bin(int iface, Chunk &chunk) const;
+
+            // Concatenates the triangles and bins of the first n_chunks chunks, in order, into
+            // _triangles and the tiles' bins, adding their culling stats to culling_stats
+            void merge_chunks(int n_chunks, Culling::Stats &culling_stats);
+
+            // Transforms the faces of model to clip space (shading its vertices into vertices),
+            // and bins them into the tiles, counting the work in vertex_stats and culling_stats
+            template <typename ShaderT>
+            void transform_and_bin(
+                const ShaderT &shader, Obj::Model &model, PostTransform::Buffer<ShaderT> &vertices,
+                PostTransform::Stats &vertex_stats, Culling::Stats &culling_stats
+            );
+
+        public:
+            // obs.: viewport maps NDC to the screen (i.e. [0, resolution))
+            Renderer(
+                const Types::Vec2i &resolution, const Types::Mat4f &viewport,
+                Parallel::Pool &pool,
+                const Culling::Options &culling = Culling::Options(),
+                Frame::Format format = Frame::Format::LDR
+            );
+
+            // Resets the color of all tiles to black, and their depth to MIN_FLOAT
+            void clear();
+
+            // Draws the faces of model with shader, which should already have its uniforms set
+            // obs.: all threads share shader, as triangle assembly writes the varyings of each
+            //       face to storage owned by the thread (see Interpolation::Triangle) instead
+            template <typename ShaderT>
+            void draw(const ShaderT &shader, Obj::Model &model, Draw::DepthTest depth_test = Draw::DepthTest::Less);
+
+            // Only writes the depth of the faces of model, for a depth pre-pass (see Draw::triangle_depth),
+            // so shader only needs to output clip space positions (e.g. Shaders::Depth)
+            // obs.: it isn't counted in the stats below, as the faces are drawn again by draw()
+            template <typename ShaderT>
+            void draw_depth(const ShaderT &shader, Obj::Model &model);
+
+            // Lists the lights of grid that may reach each of its tiles, with the depth bounds of the
+            // tiles' pixels (see Lights::Grid::cull), i.e. it should be called after a depth pre-pass
+            void cull_lights(Lights::Grid &grid);
+
+            // Copies the color of every tile into image (in its linear layout)
+            void resolve(TGAImage &image);
+
+            // Copies the HDR color of every tile into bgra (see Frame::Buffer::resolve_hdr)
+            void resolve_hdr(float *bgra, int stride);
+
+            // Copies the depth of every tile into depth (see Frame::Buffer::resolve_depth)
+            void resolve_depth(float *depth, int stride);
+
+            // Number of faces culled (before binning) by draw() since the renderer was created
+            const Culling::Stats &culling_stats() const;
+
+            // Number of vertices shaded (and read by triangle assembly) by draw() since the renderer was created
+            const PostTransform::Stats &vertex_stats() const;
+    };
+
+    template <typename ShaderT>
+    void Renderer::transform_and_bin(
+        const ShaderT &shader, Obj::Model &model, PostTransform::Buffer<ShaderT> &vertices,
+        PostTransform::Stats &vertex_stats, Culling::Stats &culling_stats
+    ) {
+        // run the vertex shader once per unique vertex, then gather the clip space positions of the faces,
+        // and clip, cull and bin them, one chunk of faces per task
+        vertices.shade(shader, model, _pool, vertex_stats);
+        const int n_faces = model.n_of_faces();
+        const int n_chunks = (n_faces + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        _clip_coords.resize(3 * n_faces);
+        if (static_cast<int>(_chunks.size()) < n_chunks)
+            _chunks.resize(n_chunks);
+        _pool.run(n_chunks, [&](int ichunk, int thread_id) {
+            Chunk &chunk = _chunks[ichunk];
+            chunk.triangles.clear();
+            chunk.bins.resize(_tiles.size());
+            for (std::vector<int> &bin : chunk.bins)
+                bin.clear();
+            chunk.culling_stats.clear();
+
+            const int end = std::min(n_faces, (ichunk + 1) * CHUNK_SIZE);
+            for (int i = ichunk * CHUNK_SIZE; i < end; ++i) {
+                for (int j = 0; j < 3; ++j)
+                    _clip_coords[3 * i + j] = vertices[model.unique_vertex_id(i, j)].clip_coord;
+                bin(i, chunk);
+            }
+        });
+
+        // obs.: chunks are merged in order, so that each tile draws its faces in submission order
+        //       (which keeps the output identical to that of drawing them in a single thread)
+        merge_chunks(n_chunks, culling_stats);
+    }
+
+    template <typename ShaderT>
+    void Renderer::draw(const ShaderT &shader, Obj::Model &model, Draw::DepthTest depth_test) {
+        PostTransform::Buffer<ShaderT> vertices;
+        transform_and_bin(shader, model, vertices, _vertex_stats, _culling_stats);
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            Tile &tile = _tiles[itile];
+            Interpolation::Triangle<typename ShaderT::Varyings> assembled;
+            int assembled_iface = -1;
+            for (int k : tile.bin) {
+                const Triangle &binned = _triangles[k];
+                if (binned.iface != assembled_iface) {
+                    // gather the varyings of the face, from the already shaded vertices
+                    // obs.: parts of a clipped face are binned one after the other
+                    vertices.assemble(model, binned.iface, assembled);
+                    assembled_iface = binned.iface;
+                }
+                const Clipping::Triangle &triangle = binned.triangle;
+                Draw::triangle(triangle.screen_coords, shader, assembled, tile.framebuffer,
+                               tile.origin, &tile.hiz, depth_test,
+                               triangle.is_clipped ? &triangle.weights : nullptr, &binned.edges);
+            }
+            tile.bin.clear();
+        });
+    }
+
+    template <typename ShaderT>
+    void Renderer::draw_depth(const ShaderT &shader, Obj::Model &model) {
+        PostTransform::Buffer<ShaderT> vertices;
+        PostTransform::Stats vertex_stats;
+        Culling::Stats culling_stats;
+        transform_and_bin(shader, model, vertices, vertex_stats, culling_stats);
+
+        _pool.run(static_cast<int>(_tiles.size()), [&](int itile, int thread_id) {
+            Tile &tile = _tiles[itile];
+            for (int k : tile.bin) {
+                const Triangle &binned = _triangles[k];
+                Draw::triangle_depth(binned.triangle.screen_coords, tile.framebuffer, tile.origin, &tile.hiz, &binned.edges);
+            }
+            tile.bin.clear();
+        });
+    }
+}
+
+#endif // __TILES_HH__
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "Tonemap.hh"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "Math.hh"
+#include "Simd.hh"
+
+using Types::Vec2i;
+
+namespace Tonemap {
+
+    // ref.: Narkowicz, "ACES Filmic Tone Mapping Curve" (2016), i.e. (x (a x + b)) / (x (c x + d) + e)
+    static const float ACES_A = 2.51f;
+    static const float ACES_B = 0.03f;
+    static const float ACES_C = 2.43f;
+    static const float ACES_D = 0.59f;
+    static const float ACES_E = 0.14f;
+
+    // obs.: the result isn't clamped (nor is the input), which is left to the caller
+    static inline float tone_curve(float x, Curve curve) {
+        switch (curve) {
+            case Curve::Reinhard:
+                return x / (1.0f + x);
+            case Curve::ACES:
+                return (x * (ACES_A * x + ACES_B)) / (x * (ACES_C * x + ACES_D) + ACES_E);
+            case Curve::Clamp:
+            default:
+                return x;
+        }
+    }
+
+#ifdef __SSE2__
+    static inline __m128 tone_curve(__m128 x, Curve curve) {
+        switch (curve) {
+            case Curve::Reinhard:
+                return _mm_div_ps(x, _mm_add_ps(_mm_set1_ps(1.0f), x));
+            case Curve::ACES:
+                return _mm_div_ps(
+                    _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_A), x), _mm_set1_ps(ACES_B))),
+                    _mm_add_ps(
+                        _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_C), x), _mm_set1_ps(ACES_D))),
+                        _mm_set1_ps(ACES_E)
+                    )
+                );
+            case Curve::Clamp:
+            default:
+                return x;
+        }
+    }
+#endif
+
+    Pass::Pass(const Vec2i &resolution, Parallel::Pool &pool, const Options &options)
+        : _resolution(resolution)
+        , _options(options)
+        , _pool(pool) { }
+
+    void Pass::apply(const float *bgra, TGAImage &image) const {
+        assert(image.get_width() == _resolution.x && image.get_height() == _resolution.y);
+        assert(image.get_bytespp() >= 1 && image.get_bytespp() <= 4);
+
+        _pool.run(_resolution.y, [&](int y, int thread_id) { resolve(bgra, image, y); });
+    }
+
+    void Pass::resolve(const float *bgra, TGAImage &image, int y) const {
+        const int bytespp = image.get_bytespp();
+        unsigned char *row = image.buffer() + y * _resolution.x * bytespp;
+        const float *hdr_row = bgra + 4 * y * _resolution.x;
+
+#ifdef __SSE2__
+        // the BGR lanes are exposed and tone mapped, while the alpha one is kept, and then every lane is
+        // clamped and turned into an index into the sRGB table (or into an 8-bit value, for alpha)
+        // obs.: NaNs are clamped to zero, as _mm_max_ps returns its second operand when either is NaN
+        const float exposure = _options.exposure;
+        const float lut_max = _options.srgb ? Math::SRGB_LUT_SIZE - 1.0f : 255.0f;
+        const __m128 exposures = _mm_setr_ps(exposure, exposure, exposure, 1.0f);
+        const __m128 scales = _mm_setr_ps(lut_max, lut_max, lut_max, 255.0f);
+        const __m128 is_alpha = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+        alignas(16) int32_t indices[4];
+        for (int x = 0; x < _resolution.x; ++x) {
+            const __m128 exposed = _mm_mul_ps(_mm_loadu_ps(hdr_row + 4 * x), exposures);
+            __m128 mapped = Simd::select(is_alpha, exposed, tone_curve(exposed, _options.curve));
+            mapped = _mm_min_ps(_mm_max_ps(mapped, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            _mm_store_si128(
+                reinterpret_cast<__m128i *>(indices),
+                _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(mapped, scales), _mm_set1_ps(0.5f))) // rounded
+            );
+
+            unsigned char pixel[4];
+            for (int c = 0; c < 3; ++c)
+                pixel[c] = _options.srgb ? Math::LINEAR_TO_SRGB8[indices[c]] : static_cast<unsigned char>(indices[c]);
+            pixel[3] = static_cast<unsigned char>(indices[3]);
+            std::memcpy(row + x * bytespp, pixel, bytespp);
+        }
+#else
+        for (int x = 0; x < _resolution.x; ++x) {
+            const float *hdr = hdr_row + 4 * x;
+            unsigned char pixel[4];
+            for (int c = 0; c < 3; ++c) {
+                const float mapped = Math::saturate(tone_curve(hdr[c] * _options.exposure, _options.curve));
+                pixel[c] = _options.srgb
+                         ? Math::linear_to_srgb8(mapped)
+                         : static_cast<unsigned char>(255.0f * mapped + 0.5f);
+            }
+            pixel[3] = static_cast<unsigned char>(255.0f * Math::saturate(hdr[3]) + 0.5f);
+            std::memcpy(row + x * bytespp, pixel, bytespp);
+        }
+#endif
+    }
+}
\ No newline at end of file
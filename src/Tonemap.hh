@@ -0,0 +1,54 @@
+#ifndef __TONEMAP_HH__
+#define __TONEMAP_HH__
+
+#include "tgaimage.hh"
+
+#include "Types.hh"
+#include "Parallel.hh"
+
+namespace Tonemap {
+
+    ///////////////////////////////////////////////////////
+    /// Options ///////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Curve that maps (exposed) HDR values, in [0, inf), into [0, 1]
+    enum class Curve {
+        Clamp,    // none, i.e. values above 1 are clipped (as in an LDR framebuffer)
+        Reinhard, // x / (1 + x), which never clips
+        ACES,     // fit of the ACES filmic curve, with a toe and a shoulder (clipping above about 7)
+    };
+
+    struct Options {
+        float exposure = 1.0f; // scales the colors before the curve
+        Curve curve = Curve::ACES;
+        bool srgb = true;      // encode the colors with the sRGB transfer function (else they're kept linear)
+    };
+
+    ///////////////////////////////////////////////////////
+    /// Pass //////////////////////////////////////////////
+    ///////////////////////////////////////////////////////
+
+    // Resolve of an HDR framebuffer (see Frame::Format) into an 8-bit image, after rasterization:
+    // the BGR channels of each pixel are scaled by the exposure, mapped by the tone curve and sRGB
+    // encoded (through Math's table, so without calling pow), while its alpha is only clamped
+    // obs.: each pixel's channels are transformed at once, in the lanes of a SIMD vector (with SSE2)
+    class Pass {
+        private:
+            Types::Vec2i _resolution;
+            Options _options;
+            Parallel::Pool &_pool;
+
+            // Writes row y of image
+            void resolve(const float *bgra, TGAImage &image, int y) const;
+
+        public:
+            Pass(const Types::Vec2i &resolution, Parallel::Pool &pool, const Options &options = Options());
+
+            // Writes the tone mapped colors of bgra, which is in a linear layout (see Frame::Buffer::resolve_hdr),
+            // into image (in the same layout, i.e. before flipping it), keeping image.get_bytespp() channels
+            void apply(const float *bgra, TGAImage &image) const;
+    };
+}
+
+#endif // __TONEMAP_HH__
\ No newline at end of file
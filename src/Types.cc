@@ -270,6 +270,12 @@ namespace Types {
         , _31(m._31), _32(m._32), _33(m._33), _34(m._34)
         , _41(m._41), _42(m._42), _43(m._43), _44(m._44) { }
 
+    Mat4f &Mat4f::operator=(const Mat4f &m) {
+        for (int i = 0; i < 16; ++i)
+            _m[i] = m._m[i];
+        return *this;
+    }
+
     /// indexing //////////////////////////////////////////
 
     // i-th row, starting at 0 (ending at 3)
@@ -671,6 +671,8 @@ namespace Types {
 
         Mat4f(const Mat4f &m);
 
+        Mat4f &operator=(const Mat4f &m);
+
         /// indexing //////////////////////////////////////////
 
         // i-th row, starting at 0 (ending at 3)
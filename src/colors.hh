@@ -1,7 +1,7 @@
 #ifndef __COLORS_HH__
 #define __COLORS_HH__
 
-#include "TGAImage.hh"
+#include "tgaimage.hh"
 
 const TGAColor black   = TGAColor( 0 ,  0 ,  0 );
 const TGAColor white   = TGAColor(255, 255, 255);
@@ -1,12 +1,28 @@
+#include <cmath>
+#include <memory>
+#include <type_traits>
+
 #include "colors.hh"
 #include "tgaimage.hh"
 
 #include "Obj.hh"
+#include "HiZ.hh"
 #include "Draw.hh"
+#include "Frame.hh"
 #include "Math.hh"
 #include "Types.hh"
+#include "Tiles.hh"
+#include "Lights.hh"
+#include "Culling.hh"
+#include "Clipping.hh"
 #include "Shaders.hh"
+#include "Shadows.hh"
+#include "Tonemap.hh"
+#include "Textures.hh"
+#include "Occlusion.hh"
 #include "Geometry.hh"
+#include "Parallel.hh"
+#include "PostTransform.hh"
 #include "Transform.hh"
 #include "Primitives.hh"
 
@@ -20,7 +36,6 @@ using Types::Vec4f; // homogeneous coordinates (points with w=1, vectors with w=
 using Types::Mat4f;
 using Types::Mat3f;
 
-Obj::Model *model = nullptr;
 const Vec2i resolution(800, 800);
 const Mat4f viewport = Transform::viewport(//resolution.x, resolution.y, 1);
     resolution.x / 8, resolution.y / 8, 3 * resolution.x / 4, 3 * resolution.y / 4, 0, 1
@@ -31,6 +46,15 @@ const Vec3f eye(1, 1, 3); // (0, 0, focal_dist)
 const Vec3f center(0, 0, 0); // target
 const Vec3f light_direction = Vec3f(1, 1, 1).normalize();
 
+const bool use_tiles = true; // bin faces into screen tiles, and rasterize them in parallel
+const bool use_depth_prepass = true; // draw depth first, so that only visible pixels are shaded
+const bool use_shadows = true; // shadow the light with a shadow map (rendered only when the light or models change)
+const bool use_ssao = true; // darken the image by its ambient occlusion, computed from the depth buffer
+const bool use_hdr = false; // shade in linear space to float colors, which are tone mapped into the image
+const bool use_lights = false; // also light the models with a ring of local lights (with Phong lighting, culled per screen tile)
+const int n_threads = 0; // 0 uses all hardware threads
+const bool print_stats = false; // print the vertex, culling, shadow map and texture cache stats to stderr
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         std::cerr << "usage: ./" << argv[0]
@@ -40,37 +64,188 @@ int main(int argc, char **argv) {
     }
 
     TGAImage image(resolution.x, resolution.y, TGAImage::RGB);
-    float *z_buffer = new float[resolution.x * resolution.y];
-    for (int i = 0; i < resolution.x * resolution.y; ++i) {
-        z_buffer[i] = Math::MIN_FLOAT;
+    const Frame::Format format = use_hdr ? Frame::Format::HDR : Frame::Format::LDR;
+
+    // obs.: the full-screen framebuffer (and its HiZ pyramid) is only allocated when drawing
+    //       without tiles, as the tiles have their own otherwise
+    std::unique_ptr<Frame::Buffer> framebuffer;
+    std::unique_ptr<HiZ::Pyramid> hiz;
+    if (!use_tiles) {
+        framebuffer = std::make_unique<Frame::Buffer>(resolution, format);
+        hiz = std::make_unique<HiZ::Pyramid>(resolution);
     }
 
     const Mat4f model_view = Transform::look_at(eye, center, up);
     const Mat4f projection = Transform::projection((eye - center).length());
     const Mat4f mvp = projection * model_view;
 
-    Shaders::Texture shader;
-    shader.uniform_viewport = viewport;
+    // obs.: only Phong lighting adds up the local lights
+    std::conditional<use_lights, Shaders::Phong, Shaders::Texture>::type shader;
     shader.uniform_mvp = mvp;
     shader.uniform_mvp_inv_T = mvp.inversed().transposed();
     shader.uniform_light_direction = (mvp * Vec4f(light_direction, 0)).xyz().normalize();
+    shader.uniform_linear = use_hdr;
+    shader.uniform_ka = 5.0f;
+    shader.uniform_kd = 1.0f;
+    shader.uniform_ks = 0.5f;
 
-    for (int m = 1; m < argc; ++m) {
-        model = new Obj::Model(argv[m]);
-        shader.uniform_model = model;
+    // point lights of every hue, on a ring around the models (in object space, as the eye)
+    Lights::Grid lights(resolution);
+    if (use_lights) {
+        const int n_lights = 16;
+        std::vector<Lights::Light> ring;
+        for (int i = 0; i < n_lights; ++i) {
+            const float angle = 2.0f * Math::PI * i / n_lights;
+            const Vec3f hue(
+                0.5f + 0.5f * std::cos(angle),
+                0.5f + 0.5f * std::cos(angle - 2.0f * Math::PI / 3.0f),
+                0.5f + 0.5f * std::cos(angle + 2.0f * Math::PI / 3.0f)
+            ); // RGB
+            const Vec3f position = center + Vec3f(std::cos(angle), 0.0f, std::sin(angle)) * 1.1f;
+            ring.push_back(Lights::Light::point(position, hue * 3.0f, 1.0f));
+        }
+        lights.set_lights(ring, mvp, viewport);
+        shader.uniform_lights = &lights;
+        shader.uniform_eye = eye;
+    }
+
+    Culling::Options culling; // back faces, off-screen and empty triangles
+    Culling::Stats culling_stats;
+
+    Parallel::Pool pool(n_threads);
+    Tiles::Renderer renderer(resolution, viewport, pool, culling, format);
+
+    // obs.: models are kept loaded until the end, since a depth pre-pass draws them twice
+    std::vector<Obj::Model *> models;
+    for (int m = 1; m < argc; ++m)
+        models.push_back(new Obj::Model(argv[m]));
+
+    // the shadow map views a sphere around every model from the light
+    Shadows::Map shadow_map(1024, pool);
+    if (use_shadows) {
+        float radius = 0.0f;
+        for (Obj::Model *model : models)
+            for (int i = 0; i < model->n_of_vertices(); ++i)
+                radius = std::max(radius, (model->position(i) - center).length());
+        shadow_map.update(Shadows::directional_light_mvp(light_direction, center, radius), models);
+        shader.uniform_shadow_map = &shadow_map;
+    }
+
+    // with a depth pre-pass, only the fragments matching the closest depth are shaded
+    const Draw::DepthTest depth_test = use_depth_prepass ? Draw::DepthTest::Equal : Draw::DepthTest::Less;
+
+    PostTransform::Stats vertex_stats;
+
+    auto draw_with = [&](const auto &shader, Obj::Model *model, bool depth_only) {
+        if (use_tiles) {
+            if (depth_only)
+                renderer.draw_depth(shader, *model);
+            else
+                renderer.draw(shader, *model, depth_test);
+            return;
+        }
+
+        // obs.: as with the tiles, only the color pass is counted, as the pre-pass draws the same faces
+        PostTransform::Stats depth_vertex_stats;
+        Culling::Stats depth_culling_stats;
+        PostTransform::Stats &pass_vertex_stats = depth_only ? depth_vertex_stats : vertex_stats;
+        Culling::Stats &pass_culling_stats = depth_only ? depth_culling_stats : culling_stats;
+
+        // run the vertex shader once per unique vertex, then assemble the faces from its outputs
+        typedef typename std::decay<decltype(shader)>::type ShaderT;
+        PostTransform::Buffer<ShaderT> vertices;
+        vertices.shade(shader, *model, pool, pass_vertex_stats);
         for (int i = 0; i < model->n_of_faces(); ++i) {
-            Vec3f screen_coords[3];
-            for (int j = 0; j < 3; ++j)
-                screen_coords[j] = shader.vertex(i, j);
-            Draw::triangle(screen_coords, shader, image, z_buffer);
+            Interpolation::Triangle<typename ShaderT::Varyings> assembled;
+            vertices.assemble(*model, i, assembled);
+
+            Clipping::Triangle triangles[Clipping::MAX_TRIANGLES];
+            const int n_triangles = Clipping::clip(assembled.clip_coords, viewport, triangles);
+            for (int k = 0; k < n_triangles; ++k) {
+                const Clipping::Triangle &triangle = triangles[k];
+                Geometry::TriangleEdges edges;
+                if (Culling::cull(triangle.screen_coords, resolution, culling, pass_culling_stats, edges))
+                    continue;
+                if (depth_only)
+                    Draw::triangle_depth(triangle.screen_coords, *framebuffer, Vec2i(0, 0), hiz.get(), &edges);
+                else
+                    Draw::triangle(triangle.screen_coords, shader, assembled, *framebuffer, Vec2i(0, 0), hiz.get(),
+                                   depth_test, triangle.is_clipped ? &triangle.weights : nullptr, &edges);
+            }
         }
+    };
+
+    // the pre-pass only needs the vertices' positions, which the depth shader computes the same way
+    if (use_depth_prepass) {
+        Shaders::Depth depth_shader;
+        depth_shader.uniform_mvp = mvp;
+        for (Obj::Model *model : models) {
+            depth_shader.uniform_model = model;
+            draw_with(depth_shader, model, true);
+        }
+    }
+
+    // list the lights of each screen tile, which are also culled by depth after a pre-pass
+    if (use_lights) {
+        if (use_tiles)
+            renderer.cull_lights(lights);
+        else
+            lights.cull(*framebuffer);
+    }
+
+    // draw each model with the permutation of the shader that only samples the maps it has
+    for (Obj::Model *model : models) {
+        shader.uniform_model = model;
+        Shaders::with_maps_of(*model, shader, [&](const auto &permutation) {
+            draw_with(permutation, model, false);
+        });
+    }
+
+    if (print_stats) {
+        if (use_tiles) {
+            culling_stats = renderer.culling_stats();
+            vertex_stats = renderer.vertex_stats();
+        }
+        std::cerr << vertex_stats << std::endl;
+        std::cerr << culling_stats << std::endl;
+        if (use_shadows)
+            std::cerr << shadow_map.stats() << std::endl;
+        std::cerr << Textures::cache().stats() << std::endl;
+    }
+
+    for (Obj::Model *model : models)
         delete model;
+
+    // convert the framebuffer(s) to the image's linear layout
+    if (use_hdr) {
+        std::vector<float> bgra(4 * resolution.x * resolution.y);
+        if (use_tiles)
+            renderer.resolve_hdr(bgra.data(), resolution.x);
+        else
+            framebuffer->resolve_hdr(bgra.data(), resolution.x);
+
+        Tonemap::Pass tonemap(resolution, pool);
+        tonemap.apply(bgra.data(), image);
+    } else if (use_tiles) {
+        renderer.resolve(image);
+    } else {
+        framebuffer->resolve(image);
+    }
+
+    if (use_ssao) {
+        std::vector<float> depth(resolution.x * resolution.y);
+        if (use_tiles)
+            renderer.resolve_depth(depth.data(), resolution.x);
+        else
+            framebuffer->resolve_depth(depth.data(), resolution.x);
+
+        Occlusion::Pass ssao(resolution, projection, viewport, pool);
+        ssao.apply(depth.data(), image);
     }
 
     image.flip_vertically(); // have the origin at the bottom left corner of the image
     image.write_tga_file("../output.tga");
 
-    delete[] z_buffer;
     return 0;
 }
 